@@ -1,48 +1,39 @@
 //box_inspector.cpp implementation of class/library
 #include <box_inspector/box_inspector2.h>
+#include "box_inspector2_ext.h"
+#include "latency_stats.h" //per-stage timing, see LATENCY_SCOPE()
 //#include "box_inspector_fncs.cpp" //more code, outside this file
 #include "box_inspector_fncs2.cpp" //more code, outside this file
+#include "box_inspector_core.cpp" //ROS-free geometry and classification
+#include "box_inspector_part_types.cpp" //interned part-type ids
+#include "box_inspector_pose_utils.cpp" //pose fusion, comparison and batched transforms
+#include "box_inspector_snapshots.cpp" //event-driven box-camera frames
+#include "box_inspector_recording.cpp" //binary recording of sensor streams
+#include "box_inspector_stations.cpp" //table of inspection stations
+#include "box_inspector_matching.cpp" //optimal observed/desired part assignment
+#include "box_inspector_templates.cpp" //box-relative shipment templates
 #include <math.h>
 using namespace std;
 
 BoxInspector2::BoxInspector2(ros::NodeHandle* nodehandle) : nh_(*nodehandle) { //constructor
     //set up camera subscriber:
     ROS_INFO("box-inspector  constructor");
-    box_camera_subscriber_ = nh_.subscribe("/ariac/box_camera_1", 1, &BoxInspector2::box_camera_callback, this);
+    //one box camera and one quality sensor per inspection station; see box_inspector_stations.cpp
+    //box cams and quality sensors are serviced by their own spinner thread; see box_inspector_snapshots.cpp
+    ros::NodeHandle box_cam_nh(nh_);
+    box_cam_nh.setCallbackQueue(&g_box_cam_queue);
+    subscribe_inspection_stations(box_cam_nh);
     got_new_snapshot_ = false; //trigger to get new snapshots
-    box_camera_subscriber2_ = nh_.subscribe("/ariac/box_camera_2", 1, &BoxInspector2::box_camera_callback2, this);
-    //    box_camera_2_subscriber_ = nh_.subscribe("/ariac/box_camera_2", 1,
-    //        &ConveyorActionServer::box_camera_2_callback, this);
-    got_new_snapshot2_ = false; //trigger to get new snapshots
-    //  geometry_msgs::PoseStamped NOM_BOX1_POSE_WRT_WORLD,NOM_BOX2_POSE_WRT_WORLD;
-    // assign hard-coded nominal vals for boxes at Q1 and Q1:
-    //0.55, 0.61, 0.588; rpy = 0,0,0
-    NOM_BOX1_POSE_WRT_WORLD.header.frame_id = "world";
-    NOM_BOX1_POSE_WRT_WORLD.pose.position.x = 0.55;
-    NOM_BOX1_POSE_WRT_WORLD.pose.position.y = 0.61;
-    NOM_BOX1_POSE_WRT_WORLD.pose.position.z = 0.588;
-    NOM_BOX1_POSE_WRT_WORLD.pose.orientation.x = 0.0;
-    NOM_BOX1_POSE_WRT_WORLD.pose.orientation.y = 0.0;
-    NOM_BOX1_POSE_WRT_WORLD.pose.orientation.z = 0.0;
-    NOM_BOX1_POSE_WRT_WORLD.pose.orientation.w = 1.0;
-
-    NOM_BOX2_POSE_WRT_WORLD = NOM_BOX1_POSE_WRT_WORLD;
-    NOM_BOX2_POSE_WRT_WORLD.pose.position.y = 0.266;
-
-    quality_sensor_1_subscriber_ = nh_.subscribe("/ariac/quality_control_sensor_1", 1,
-            &BoxInspector2::quality_sensor_1_callback, this);
-    qual_sensor_1_sees_faulty_part_ = false;
-
-    quality_sensor_2_subscriber_ = nh_.subscribe("/ariac/quality_control_sensor_2", 1,
-            &BoxInspector2::quality_sensor_2_callback, this);
-    qual_sensor_2_sees_faulty_part_ = false;
-    ROS_INFO("testing cam2...");
-            while (!got_new_snapshot2_) {
-                ros::spinOnce();
-                ros::Duration(1).sleep();
-                ROS_INFO("waiting for boxcam2");
-            }
-    ROS_INFO("got a snapshot from boxcam2");
+    got_new_snapshot2_ = false;
+    //nominal box poses, for the obsolete CAM1-only functions
+    NOM_BOX1_POSE_WRT_WORLD = nominal_box_pose(INSPECTION_STATIONS[0]);
+    NOM_BOX2_POSE_WRT_WORLD = nominal_box_pose(INSPECTION_STATIONS[1]);
+    load_pose_tolerance_profile(nh_);
+    load_quality_sensor_params(nh_);
+    start_recording_from_params(nh_);
+    start_box_cam_spinner();
+    //no waiting here: the sensors warm up in the background; see wait_for_inspection_stations()
+    ROS_INFO("box cameras and quality sensors subscribed");
 }
 
 void part_to_model(inventory_msgs::Part part, osrf_gear::Model &model) {
@@ -51,129 +42,82 @@ void part_to_model(inventory_msgs::Part part, osrf_gear::Model &model) {
 
 }
 
+//the per-station callbacks and functions below all delegate to one implementation, parameterized by
+// station (see box_inspector_stations.cpp)
 void BoxInspector2::quality_sensor_1_callback(const osrf_gear::LogicalCameraImage::ConstPtr & image_msg) {
-    qual_sensor_1_image_ = *image_msg;
-    //ROS_INFO("got Qsensor1 msg...");
-    qual_sensor_1_sees_faulty_part_ = find_faulty_part_Q1(qual_sensor_1_image_, bad_part_Qsensor1_);
-    got_new_Q1_image_ = true;
+    quality_sensor_callback_for(CAM1, image_msg);
 }
 
 void BoxInspector2::quality_sensor_2_callback(const osrf_gear::LogicalCameraImage::ConstPtr & image_msg) {
-    qual_sensor_2_image_ = *image_msg;
-    qual_sensor_2_sees_faulty_part_ = find_faulty_part_Q2(qual_sensor_2_image_, bad_part_Qsensor2_);
-    got_new_Q2_image_ = true;
+    quality_sensor_callback_for(CAM2, image_msg);
 }
 
 //note: this function returns only the FIRST faulty part found;
 //but that should be suitable for our use
 // returns part coords w/rt world in "bad_part" object
+// (get_faulty_parts(), in box_inspector2_ext.h, reports all of them)
 bool  BoxInspector2::find_faulty_part_Q(const osrf_gear::LogicalCameraImage qual_sensor_image,inventory_msgs::Part &bad_part, int cam_num) {
-    switch (cam_num) {
-        case CAM1:
-            return find_faulty_part_Q1(qual_sensor_image,bad_part);
-            break;
-        case CAM2:
-            return find_faulty_part_Q2(qual_sensor_image,bad_part);
-            break;
-        default:
-            ROS_WARN("find_faulty_part_Q: cam num not recognized! "); 
-            return false;
-    }      
-      
-  }
-  
-  
-bool BoxInspector2::find_faulty_part_Q1(const osrf_gear::LogicalCameraImage qual_sensor_image,
-        inventory_msgs::Part &bad_part) {
+    const InspectionStationConfig *station = inspection_station_config(cam_num);
+    if (!station) {
+        ROS_WARN("find_faulty_part_Q: cam num not recognized! "); 
+        return false;
+    }
     int num_bad_parts = qual_sensor_image.models.size();
     if (num_bad_parts == 0) return false;
     //if here, find a bad part and populate bad_part w/ pose in world coords
-    osrf_gear::Model model = qual_sensor_image.models[0];
-    geometry_msgs::Pose cam_pose, part_pose;
-    geometry_msgs::PoseStamped stPose_part_wrt_world;
-    cam_pose = qual_sensor_image.pose;
-    part_pose = model.pose;
+    const osrf_gear::Model &model = qual_sensor_image.models[0];
     bad_part.name = model.type;
-    stPose_part_wrt_world = compute_stPose(cam_pose, part_pose);
-    bad_part.pose = stPose_part_wrt_world;
-    bad_part.location = inventory_msgs::Part::QUALITY_SENSOR_1;
+    bad_part.pose = compute_stPose(qual_sensor_image.pose, model.pose);
+    bad_part.location = station->location_code;
     return true;
 }
 
+bool BoxInspector2::find_faulty_part_Q1(const osrf_gear::LogicalCameraImage qual_sensor_image,
+        inventory_msgs::Part &bad_part) {
+    return find_faulty_part_Q(qual_sensor_image, bad_part, CAM1);
+}
+
 bool BoxInspector2::find_faulty_part_Q2(const osrf_gear::LogicalCameraImage qual_sensor_image,
         inventory_msgs::Part &bad_part) {
-    int num_bad_parts = qual_sensor_image.models.size();
-    if (num_bad_parts == 0) return false;
-    //if here, find a bad part and populate bad_part w/ pose in world coords
-    osrf_gear::Model model = qual_sensor_image.models[0];
-    geometry_msgs::Pose cam_pose, part_pose;
-    geometry_msgs::PoseStamped stPose_part_wrt_world;
-    cam_pose = qual_sensor_image.pose;
-    part_pose = model.pose;
-    bad_part.name = model.type;
-    stPose_part_wrt_world = compute_stPose(cam_pose, part_pose);
-    bad_part.pose = stPose_part_wrt_world;
-    bad_part.location = inventory_msgs::Part::QUALITY_SENSOR_2;
-    return true;
+    return find_faulty_part_Q(qual_sensor_image, bad_part, CAM2);
 }
 
 bool BoxInspector2::get_bad_part_Q1(inventory_msgs::Part &bad_part) {
-    got_new_Q1_image_ = false;
-    double wait_time = 0;
-    double dt = 0.1;
-    while ((wait_time < QUALITY_INSPECTION_MAX_WAIT_TIME)&&!got_new_Q1_image_) {
-        wait_time += dt;
-        ros::spinOnce();
-        ros::Duration(dt).sleep();
-    }
-    if (wait_time >= QUALITY_INSPECTION_MAX_WAIT_TIME) {
-        ROS_WARN("timed  out waiting for quality inspection cam1");
-        return false;
-    }
-    //if here, then got an update from Q1 cam:
-    bad_part = bad_part_Qsensor1_;
-    return qual_sensor_1_sees_faulty_part_;
+    return get_bad_part_Q(bad_part, CAM1);
 }
 
+//uses the latest quality-sensor reading if no older than box_inspector/quality_sensor_max_age; waits
+// (up to QUALITY_INSPECTION_MAX_WAIT_TIME) only if it is older
 bool BoxInspector2::get_bad_part_Q(inventory_msgs::Part &bad_part,int cam_num) {
-    switch (cam_num) {
-        case CAM1:
-            return get_bad_part_Q1(bad_part);
-            break;
-        case CAM2:
-            return get_bad_part_Q2(bad_part);
-            break;
-        default:
-            ROS_WARN("get_bad_part_Q: cam num not recognized! ");
-            return false;
+    if (!inspection_station_config(cam_num)) {
+        ROS_WARN("get_bad_part_Q: cam num not recognized! ");
+        return false;
     }
+    QualitySensorReadingConstPtr reading;
+    if (!get_quality_sensor_reading(cam_num, g_quality_sensor_max_age, QUALITY_INSPECTION_MAX_WAIT_TIME, reading)) {
+        ROS_WARN("timed  out waiting for quality inspection cam%d", cam_num);
+        return false;
+    }
+    //if here, then have a recent reading from this station's quality sensor:
+    if (reading->faulty_parts.empty()) return false;
+    bad_part = reading->faulty_parts[0];
+    return true;
 }  
 
 bool BoxInspector2::get_bad_part_Q2(inventory_msgs::Part &bad_part) {
-    got_new_Q2_image_ = false;
-    double wait_time = 0;
-    double dt = 0.1;
-    while ((wait_time < QUALITY_INSPECTION_MAX_WAIT_TIME)&&!got_new_Q2_image_) {
-        wait_time += dt;
-        ros::spinOnce();
-        ros::Duration(dt).sleep();
-    }
-    if (wait_time >= QUALITY_INSPECTION_MAX_WAIT_TIME) {
-        ROS_WARN("timed  out waiting for quality inspection cam2");
-        return false;
-    }
-    //if here, then got an update from Q2 cam:
-    bad_part = bad_part_Qsensor2_;
-    return qual_sensor_2_sees_faulty_part_;
+    return get_bad_part_Q(bad_part, CAM2);
 }
 
+//the wrappers below inspect into the station's InspectionReport and copy out only what they return,
+// rather than filling (and discarding) all nine update_inspection() vectors
 bool BoxInspector2::find_orphan_parts(vector<osrf_gear::Model> desired_models_wrt_world, vector<osrf_gear::Model> &orphan_models,int cam_num) {
-
-    vector<osrf_gear::Model> satisfied_models_wrt_world, misplaced_models_desired_coords_wrt_world, misplaced_models_actual_coords_wrt_world, missing_wrt_world;
-    vector<int> part_indices_missing,part_indices_misplaced,part_indices_precisely_placed;
-    if (!update_inspection(desired_models_wrt_world, satisfied_models_wrt_world, misplaced_models_actual_coords_wrt_world, misplaced_models_desired_coords_wrt_world, missing_wrt_world, orphan_models,part_indices_missing,part_indices_misplaced,part_indices_precisely_placed,cam_num)) {
+    if (!get_inspection_report(cam_num)) return 0;
+    osrf_gear::LogicalCameraImage filtered_box_camera_image;
+    if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
         return 0;
     }
+    const InspectionReport &report = classify_station(cam_num, filtered_box_camera_image, desired_models_wrt_world);
+    gather_models(report.observed_models, report.orphans, orphan_models);
     if (orphan_models.size() == 0) {
         return 0;
     }
@@ -181,14 +125,13 @@ bool BoxInspector2::find_orphan_parts(vector<osrf_gear::Model> desired_models_wr
 }
 
 bool BoxInspector2::find_missing_parts(vector<osrf_gear::Model> desired_models_wrt_world, vector<osrf_gear::Model> &missing_wrt_world, int cam_num) {
-    vector<osrf_gear::Model> satisfied_models_wrt_world, misplaced_models_desired_coords_wrt_world, misplaced_models_actual_coords_wrt_world, orphan_models_wrt_world;
-    vector<int> part_indices_missing,part_indices_misplaced,part_indices_precisely_placed;
-
-    if (!update_inspection(desired_models_wrt_world, satisfied_models_wrt_world, misplaced_models_actual_coords_wrt_world, 
-            misplaced_models_desired_coords_wrt_world, missing_wrt_world, orphan_models_wrt_world, 
-            part_indices_missing,part_indices_misplaced,part_indices_precisely_placed,cam_num)) {
+    if (!get_inspection_report(cam_num)) return 0;
+    osrf_gear::LogicalCameraImage filtered_box_camera_image;
+    if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
         return 0;
     }
+    const InspectionReport &report = classify_station(cam_num, filtered_box_camera_image, desired_models_wrt_world);
+    gather_models(desired_models_wrt_world, report.missing, missing_wrt_world);
     if (missing_wrt_world.size() == 0) {
         return 0;
     }
@@ -204,13 +147,14 @@ void BoxInspector2::model_to_part(osrf_gear::Model model, inventory_msgs::Part &
 
 
 bool BoxInspector2::post_dropoff_check(vector<osrf_gear::Model> desired_models_wrt_world, vector<osrf_gear::Model> &misplaced_models_desired_coords, vector<osrf_gear::Model> &misplaced_models_actual_coords, int cam_num) {
-    vector<osrf_gear::Model> satisfied_models_wrt_world, missing_models_wrt_world, orphan_models_wrt_world;
-        vector<int> part_indices_missing,part_indices_misplaced,part_indices_precisely_placed;
-
-    if (!update_inspection(desired_models_wrt_world, satisfied_models_wrt_world, misplaced_models_actual_coords, misplaced_models_desired_coords, 
-            missing_models_wrt_world, orphan_models_wrt_world,part_indices_missing,part_indices_misplaced,part_indices_precisely_placed,cam_num)) {
+    if (!get_inspection_report(cam_num)) return 0;
+    osrf_gear::LogicalCameraImage filtered_box_camera_image;
+    if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
         return 0;
     }
+    const InspectionReport &report = classify_station(cam_num, filtered_box_camera_image, desired_models_wrt_world);
+    gather_models(desired_models_wrt_world, report.misplaced, misplaced_models_desired_coords);
+    gather_models(report.observed_models, report.misplaced_observed, misplaced_models_actual_coords);
 
     if (misplaced_models_desired_coords.size() == 0 || misplaced_models_actual_coords.size() == 0) {
         return 0;
@@ -223,47 +167,34 @@ bool BoxInspector2::post_dropoff_check(vector<osrf_gear::Model> desired_models_w
 
 bool BoxInspector2::pre_dropoff_check(inventory_msgs::Part part, osrf_gear::Model misplaced_model_actual_coords, osrf_gear::Model misplaced_model_desired_coords, int cam_num) {
     osrf_gear::Model model;
-    vector<osrf_gear::Model> desired, satisfied_models_wrt_world, missing_models_wrt_world, orphan_models_wrt_world, misplaced_models_actual_coords, misplaced_models_desired_coords;
-    vector<int> part_indices_missing,part_indices_misplaced,part_indices_precisely_placed;
+    vector<osrf_gear::Model> desired;
 
     //part_to_model(part,model);
     model.type = part.name;
     model.pose = part.pose.pose;
     desired.clear();
     desired.push_back(model);
-    if (!update_inspection(desired, satisfied_models_wrt_world, misplaced_models_actual_coords, misplaced_models_desired_coords, 
-            missing_models_wrt_world, orphan_models_wrt_world,part_indices_missing,part_indices_misplaced,part_indices_precisely_placed,cam_num)) {
+    if (!get_inspection_report(cam_num)) return 0;
+    osrf_gear::LogicalCameraImage filtered_box_camera_image;
+    if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
         return 0;
     }
-    if (misplaced_models_desired_coords.size() == 0) {
+    //single-part check: don't disturb the station's cached full-shipment classification
+    const InspectionReport &report = classify_station(cam_num, filtered_box_camera_image, desired, false);
+    if (report.misplaced.size() == 0) {
         ROS_INFO("pre drop off check good");
         return 0;
     } else {
-        misplaced_model_desired_coords = misplaced_models_desired_coords[0];
-        misplaced_model_actual_coords = misplaced_models_actual_coords[0];
+        misplaced_model_desired_coords = desired[report.misplaced[0]];
+        misplaced_model_actual_coords = report.observed_models[report.misplaced_observed[0]];
         return 1;
     }
 
 }
 
+//tolerance tests work directly on quaternions; see PoseTolerance in box_inspector_pose_utils.cpp
 bool BoxInspector2::compare_pose(geometry_msgs::Pose pose_A, geometry_msgs::Pose pose_B) {
-    Eigen::Affine3d affine1, affine2;
-    Eigen::Vector3d origin_diff;
-    affine1 = xformUtils_.transformPoseToEigenAffine3d(pose_A);
-    affine2 = xformUtils_.transformPoseToEigenAffine3d(pose_B);
-    origin_diff = affine1.translation() - affine2.translation();
-    double origin_err = origin_diff.norm();
-    Eigen::Matrix3d R1, R2, R_diff;
-    R1 = affine1.linear();
-    R2 = affine2.linear();
-    R_diff = R1.inverse() * R2;
-    Eigen::AngleAxisd angleAxis(R_diff);
-    double rotation_err = angleAxis.angle();
-    if (origin_err < ORIGIN_ERR_TOL && rotation_err < ORIENTATION_ERR_TOL) { //hard-coded tolerances per ARIAC
-        return true;
-    } else {
-        return false;
-    }
+    return pose_within_tolerance(pose_A, pose_B, g_pose_tolerances.precise); //hard-coded tolerances per ARIAC
 }
 
 bool BoxInspector2::compare_pose(geometry_msgs::PoseStamped pose_stamped_A, geometry_msgs::PoseStamped pose_stamped_B) {
@@ -275,23 +206,7 @@ bool BoxInspector2::compare_pose(geometry_msgs::PoseStamped pose_stamped_A, geom
 }
 
 bool BoxInspector2::compare_pose_approx(geometry_msgs::Pose pose_A, geometry_msgs::Pose pose_B) {
-    Eigen::Affine3d affine1, affine2;
-    Eigen::Vector3d origin_diff;
-    affine1 = xformUtils_.transformPoseToEigenAffine3d(pose_A);
-    affine2 = xformUtils_.transformPoseToEigenAffine3d(pose_B);
-    origin_diff = affine1.translation() - affine2.translation();
-    double origin_err = origin_diff.norm();
-    Eigen::Matrix3d R1, R2, R_diff;
-    R1 = affine1.linear();
-    R2 = affine2.linear();
-    R_diff = R1.inverse() * R2;
-    Eigen::AngleAxisd angleAxis(R_diff);
-    double rotation_err = angleAxis.angle();
-    if (origin_err < 0.03 && rotation_err < 0.3) { //as above, but with larger tolerances
-        return true;
-    } else {
-        return false;
-    }
+    return pose_within_tolerance(pose_A, pose_B, g_pose_tolerances.approx); //as above, but with larger tolerances
 }
 
 bool BoxInspector2::compare_pose_approx(geometry_msgs::PoseStamped pose_stamped_A, geometry_msgs::PoseStamped pose_stamped_B) {
@@ -303,88 +218,45 @@ bool BoxInspector2::compare_pose_approx(geometry_msgs::PoseStamped pose_stamped_
 }
 
 
-//to request a new snapshot, set need_new_snapshot_ = true, and make sure to give a ros::spinOnce()
-//!!  MAKE ANOTHER OF THESE FOR BOX CAM AT Q2
+//box-cam callbacks run on the box-cam spinner thread; they only hand the frame to whoever is waiting
 void BoxInspector2::box_camera_callback(const osrf_gear::LogicalCameraImage::ConstPtr & image_msg) {
-    if (!got_new_snapshot_) {
-        box_inspector_image_ = *image_msg; //copy the current message to a member data var, i.e. freeze the snapshot
-        got_new_snapshot_ = true;
-        //ROS_INFO_STREAM("received box-camera image of: " << box_inspector_image_ << endl);
-        int n_models = box_inspector_image_.models.size();
-        //ROS_INFO("%d models seen ", n_models);
-    }
+    box_camera_callback_for(CAM1, image_msg);
 }
 void BoxInspector2::box_camera_callback2(const osrf_gear::LogicalCameraImage::ConstPtr & image_msg) {
-    if (!got_new_snapshot2_) {
-        box_inspector_image2_ = *image_msg; //copy the current message to a member data var, i.e. freeze the snapshot
-        got_new_snapshot2_ = true;
-        //ROS_INFO_STREAM("received box-camera image of: " << box_inspector_image2_ << endl);
-        int n_models = box_inspector_image2_.models.size();
-        //if (n_models>0) ROS_INFO("%d models seen at box cam 2", n_models);
-    }
+    box_camera_callback_for(CAM2, image_msg);
 }
 //method to request a new snapshot from logical camera; blocks until snapshot is ready,
 // then result will be in box_inspector_image_ or box_inspector_image2_
+//returns as soon as the camera delivers a frame; gives up after BOX_INSPECTOR_TIMEOUT
 
 bool BoxInspector2::get_new_snapshot_from_box_cam(int cam_num) {
-    got_new_snapshot_ = false;
-    got_new_snapshot2_ = false;
-    double dt = 0.05;
-    double timer = 0.0;
+    LATENCY_SCOPE("inspector/snapshot_wait");
+    BoxCamFeed *feed = box_cam_feed(cam_num);
+    if (!feed) {
+        ROS_WARN("get_new_snapshot_from_box_cam: cam_num = %d not recognized",cam_num);
+        return false;
+    }
+    BoxCamFrameConstPtr frame;
+    if (!wait_for_box_cam_frame(*feed, BOX_INSPECTOR_TIMEOUT, frame)) {
+        ROS_WARN("could not update box%d inspection image!", cam_num);
+        return false;
+    }
     switch(cam_num) {
-        case CAM1: //box cam 1
-
-            while ((!got_new_snapshot_) && (timer < BOX_INSPECTOR_TIMEOUT)) {
-                ros::spinOnce();
-                ros::Duration(dt).sleep();
-                timer += dt;
-            }
-            if (timer >= BOX_INSPECTOR_TIMEOUT) {
-                ROS_WARN("could not update box inspection image!");
-                return false;          
-            } else {
-                //ROS_INFO("got new snapshot from boxcam 1");
-                return true;
-            }
+        case CAM1:
+            box_inspector_image_ = *(frame->image); //freeze the snapshot
+            got_new_snapshot_ = true;
             break;
         case CAM2:
-            while ((!got_new_snapshot2_) && (timer < BOX_INSPECTOR_TIMEOUT)) {
-                // ROS_WARN("FIX ME!!!");
-                ros::spinOnce();
-                ros::Duration(dt).sleep();
-                timer += dt;
-            }
-            if (timer >= BOX_INSPECTOR_TIMEOUT) {
-                ROS_WARN("could not update box2 inspection image!");
-                return false;          
-            } else {
-                //ROS_INFO("got new snapshot from boxcam 2");
-
-                return true;
-            }            
+            box_inspector_image2_ = *(frame->image);
+            got_new_snapshot2_ = true;
             break;
-         default:
-            ROS_WARN("get_new_snapshot_from_box_cam: cam_num = %d not recognized",cam_num);
-            return false;
-    }               
+    }
+    return true;
 }
 
     //obsolete...
 bool BoxInspector2::get_new_snapshot_from_box_cam2() {
-    got_new_snapshot2_ = false;
-    double dt = 0.05;
-    double timer = 0.0;
-    while (!got_new_snapshot2_ && (timer < BOX_INSPECTOR_TIMEOUT)) {
-        ros::spinOnce();
-        ros::Duration(dt).sleep();
-        timer += dt;
-    }
-    if (timer >= BOX_INSPECTOR_TIMEOUT) {
-        ROS_WARN("could not update box inspection image!");
-        return false;
-    } else {
-        return true;
-    }
+    return get_new_snapshot_from_box_cam(CAM2);
 }
 
 //obsolete...
@@ -456,86 +328,48 @@ bool BoxInspector2::get_filtered_snapshots_from_box_cam2(osrf_gear::LogicalCamer
     return true;
 }
     
-    bool BoxInspector2::get_filtered_snapshots_from_box_cam(osrf_gear::LogicalCameraImage &filtered_box_camera_image, int cam_num) {
-    int n_snapshots = 3; //choose to average this many snapshots
-    vector<geometry_msgs::Pose> sum_poses, averaged_poses;
-    //osrf_gear::LogicalCameraImage filtered_box_camera_image;
-    ROS_INFO("attempting acquire filtered snapshot from camera %d",cam_num);
-    if (!get_new_snapshot_from_box_cam(cam_num)) {
+//fuses multiple snapshots; returns a LogicalCameraImage with coordinates wrt camera frame
+//frames already held in the camera's ring buffer are used if recent enough; waits only for any shortfall
+bool BoxInspector2::get_filtered_snapshots_from_box_cam(osrf_gear::LogicalCameraImage &filtered_box_camera_image, int cam_num) {
+    LATENCY_SCOPE("inspector/filtered_snapshot");
+    int n_snapshots = 4; //choose to average this many snapshots
+    BoxCamFeed *feed = box_cam_feed(cam_num);
+    if (!feed) {
+        ROS_WARN("box-inspector: cam_num = %d not recognized",cam_num);
+        return false;
+    }
+    vector<BoxCamFrameConstPtr> frames; //newest first
+    int n_recent = get_recent_box_cam_frames(*feed, n_snapshots, BOX_CAM_MAX_FRAME_AGE, frames);
+    LATENCY_COUNT("inspector/snapshots_from_ring", n_recent);
+    if (n_recent < n_snapshots) {
+        ROS_INFO("attempting acquire %d more snapshots from camera %d", n_snapshots - n_recent, cam_num);
+    }
+    while ((int) frames.size() < n_snapshots) {
+        BoxCamFrameConstPtr frame;
+        if (!wait_for_box_cam_frame(*feed, BOX_INSPECTOR_TIMEOUT, frame)) break; //blackout? use what we have
+        frames.insert(frames.begin(), frame);
+    }
+    if (frames.empty()) {
         ROS_WARN("failed to get snapshot");
         return false;
-    } //failed to get new image; blackout?
+    }
 
-    //filtered_box_camera_image.models.resize(num_parts_seen);
-    //ROS_INFO("update_inspection: box camera saw %d objects", num_parts_seen);
-    osrf_gear::LogicalCameraImage box_inspector_image;
+    //the newest frame defines the model list; keep the member snapshot consistent with it
+    const osrf_gear::LogicalCameraImage &box_inspector_image = *(frames[0]->image);
     switch(cam_num) {
         case CAM1:
-            box_inspector_image=box_inspector_image_;
+            box_inspector_image_ = box_inspector_image;
             break;
         case CAM2:
-	    box_inspector_image=box_inspector_image2_;
-            // ROS_WARN("really should do something here...FIX ME!");
-            break;     
-        default:
-            ROS_WARN("box-inspector: cam_num = %d not recognized",cam_num);
-    } 
-    //got at least one snapshot; proceed to average
-    int num_parts_seen = box_inspector_image.models.size();
-    averaged_poses.resize(num_parts_seen);
-    sum_poses.resize(num_parts_seen);
-
-       
-
-    for (int i = 0; i < num_parts_seen; i++) { //initialize, based on first successful snapshot
-        sum_poses[i] = box_inspector_image.models[i].pose;
-    }
-
-    int i_snapshots = 1; //count how many good snapshots are to be included in  average
-    for (int i = 0; i < n_snapshots; i++) { // try for this many more snapshots
-        if (get_new_snapshot_from_box_cam(cam_num)) {
-            //filtered_box_camera_image = box_inspector_image;
-            if (box_inspector_image.models.size() == num_parts_seen) { //if here, got a new snapshot consistent w/ first snapshot;
-                //start  averaging process
-                i_snapshots++;
-                for (int j = 0; j < num_parts_seen; j++) {
-                    sum_poses[j].position.x += box_inspector_image.models[j].pose.position.x;
-                    sum_poses[j].position.y += box_inspector_image.models[j].pose.position.y;
-                    sum_poses[j].position.z += box_inspector_image.models[j].pose.position.z;
-                    sum_poses[j].orientation.x += box_inspector_image.models[j].pose.orientation.x;
-                    sum_poses[j].orientation.y += box_inspector_image.models[j].pose.orientation.y;
-                    sum_poses[j].orientation.z += box_inspector_image.models[j].pose.orientation.z;
-                    sum_poses[j].orientation.w += box_inspector_image.models[j].pose.orientation.w;
-
-                }
-            }
-        }
-    }
-    //compute averages:
-    for (int j = 0; j < num_parts_seen; j++) {
-        averaged_poses[j].position.x = sum_poses[j].position.x / i_snapshots;
-        averaged_poses[j].position.y = sum_poses[j].position.y / i_snapshots;
-        averaged_poses[j].position.z = sum_poses[j].position.z / i_snapshots;
-        averaged_poses[j].orientation.x = sum_poses[j].orientation.x / i_snapshots;
-        averaged_poses[j].orientation.y = sum_poses[j].orientation.y / i_snapshots;
-        averaged_poses[j].orientation.z = sum_poses[j].orientation.z / i_snapshots;
-        averaged_poses[j].orientation.w = sum_poses[j].orientation.w / i_snapshots;
-        //normalize the averaged  quaternion:
-        double quat_norm = sqrt(pow(averaged_poses[j].orientation.x, 2.0) + pow(averaged_poses[j].orientation.y, 2.0) + pow(averaged_poses[j].orientation.z, 2.0) + pow(averaged_poses[j].orientation.w, 2.0)); //SHOULD AVOID PERFORMANCE OVERHEAD OF MULTIPLE FNC CALL; change to x*x instead
-        averaged_poses[j].orientation.x /= quat_norm;
-        averaged_poses[j].orientation.y /= quat_norm;
-        averaged_poses[j].orientation.z /= quat_norm;
-        averaged_poses[j].orientation.w /= quat_norm;
-
+            box_inspector_image2_ = box_inspector_image;
+            break;
     }
 
-
-    //put these poses into a logical-camera image message:
-    filtered_box_camera_image = box_inspector_image; //this sets dimension, part  names,  and camera pose
-    //NOTE: all  coords are w/rt box camera frame
-    for (int i = 0; i < num_parts_seen; i++) {
-        filtered_box_camera_image.models[i].pose = averaged_poses[i];
-    }
+    //associate models across frames by type and proximity, and take a robust mean of each
+    vector<const osrf_gear::LogicalCameraImage *> images(frames.size());
+    for (int i = 0; i < (int) frames.size(); i++) images[i] = frames[i]->image.get();
+    LATENCY_SCOPE("inspector/filter");
+    fuse_box_cam_frames(images, filtered_box_camera_image); //NOTE: all  coords are w/rt box camera frame
     return true;
 }
 
@@ -548,6 +382,9 @@ bool BoxInspector2::get_filtered_snapshots_from_box_cam2(osrf_gear::LogicalCamer
 // misplaced_models_wrt_world: vector of models that belong in the shipment, but are imprecisely located in box
 // missing_models_wrt_world:  vector of models that are requested in the shipment, but not yet present in the box
 // orphan_models_wrt_world: vector of models that are seen in the box, but DO NOT belong in the box
+//observed and desired parts are paired by a single optimal assignment per part type (see box_inspector_matching.cpp),
+// so duplicate part types are paired to minimize the total correction needed
+//the same results, as index lists, remain available from get_inspection_report(cam_num) (box_inspector2_ext.h)
 
 //cam_num = 1 for station Q1, =2 for station Q2:
 //defaults to 1 if unspecified
@@ -562,254 +399,32 @@ bool BoxInspector2::update_inspection(
         vector<int> &part_indices_misplaced,
         vector<int> &part_indices_precisely_placed,
         int cam_num) {
-    int ans; // FOR DEBUG
-    osrf_gear::LogicalCameraImage filtered_box_camera_image;
-    osrf_gear::Model test_model, desired_model;
-    geometry_msgs::PoseStamped model_pose_from_image_wrt_world;
-    
-    //switch(cam_num) {
-    //    case 1: //camera 1:
-                //if blackout, DO NOT clear the model vectors!
-            if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
-                return false;
-            }
-    //        ROS_INFO("inspection with box_cam1");
-    //    break;
-    //    case 2: //camera 2:
-    //        if (!get_filtered_snapshots_from_box_cam2(filtered_box_camera_image,cam_num)) {
-    //            return false;
-    //        }            
-    //        ROS_INFO("inspection with box_cam2");
-
-    //    break;
-            
-    //    default:
-    //        ROS_WARN("camera number not recognized in BoxInspector2::update_inspection");
-    //        return false;
-                    
-    //}
-
-    //OK--got an image; can clear out and rebuild all model vectors
-    orphan_models_wrt_world.clear(); //this will be empty, unless something very odd happens
-    satisfied_models_wrt_world.clear(); //shipment will be complete when this matches parts/poses specified in shipment
-    misplaced_models_actual_coords_wrt_world.clear();
-    misplaced_models_desired_coords_wrt_world.clear();
-    missing_models_wrt_world.clear();
-    part_indices_misplaced.clear();
-    part_indices_missing.clear();
-    part_indices_precisely_placed.clear();
-
-    //ROS_INFO_STREAM("filtered box camera image" << filtered_box_camera_image);
-    int num_parts_seen = filtered_box_camera_image.models.size();
-    int num_parts_desired = desired_models_wrt_world.size();
-    vector<bool> classified_observed_part, classified_desired_part;
-    //use this to keep track of which observed  parts have been classified
-    for (int i = 0; i < num_parts_seen; i++) classified_observed_part.push_back(false);
-    for (int i = 0; i < num_parts_desired; i++) classified_desired_part.push_back(false);
-
-    //don't consider the shipping box as a part:
-    string box_name("shipping_box");
-       for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
-            test_model = filtered_box_camera_image.models[ipart_seen];
-            string test_model_name(test_model.type);
-            if (box_name == test_model_name) classified_observed_part[ipart_seen] = true;
-       }
-    
-    
-    //start with testing for bad parts:
-    inventory_msgs::Part bad_part;
-    string model_name;
-    if (get_bad_part_Q(bad_part,cam_num)) {
-        //found a bad part; match it to filtered image and classify it as orphaned
-        bool found = false;
-        int ipart_seen = 0;
-        string bad_part_name(bad_part.name);
-
-
-        //start search through seen images:
-        while ((!found)&&(ipart_seen < num_parts_seen)) {
-            test_model = filtered_box_camera_image.models[ipart_seen];
-            //string test_model_name(test_model.type);
-            //if (test_model_name != bad_part_name) {
-                //no match here; try next model seen
-            //    ipart_seen++;
-            //} else { //name matches; do coordinates match, image to bad_part?
-                //convert observed part pose to world coords:
-                model_pose_from_image_wrt_world = compute_stPose(filtered_box_camera_image.pose, test_model.pose);
-                //bad_part pose is already in world coords
-                if (compare_pose(model_pose_from_image_wrt_world.pose, bad_part.pose.pose)) {
-                    //found match!  record it
-                    found = true;
-                    classified_observed_part[ipart_seen] = true;
-                    test_model.pose = model_pose_from_image_wrt_world.pose;
-                    orphan_models_wrt_world.push_back(test_model);
-                    ROS_WARN("found a bad part--classified as orphaned");
-                } else {
-                    ipart_seen++; //not a good location match; try next candidate
-                }
-           // }
-        }
-
-        if (!found) {
-            ROS_WARN("update_inspection: SOMETHING IS WRONG.  bad part reported, but does not match any parts observed by logical cam ");
-            ROS_WARN("there seems to be a logical error in this code");
-        }
-    } else {
-        ROS_INFO("no bad parts reported by quality sensor %d",cam_num);
-    }
-    //presumably, when reach here, if any bad parts have been seen, the first one is classified as orphaned
-
-    //next, look for precise matches:
-    ROS_INFO("seeking precise matches");
-    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
-        //only consider observed parts not already classified
-        if (!classified_observed_part[ipart_seen]) {
-            test_model = filtered_box_camera_image.models[ipart_seen];
-            string test_model_name(test_model.type);
-            model_pose_from_image_wrt_world = compute_stPose(filtered_box_camera_image.pose, test_model.pose);
-            int i_des_part = 0;
-            bool found = false;
-            while ((i_des_part < num_parts_desired)&&(!found)) {
-                //step through all desired parts seeking a good match:
-                desired_model = desired_models_wrt_world[i_des_part];
-                string desired_model_name(desired_model.type);
-                if (desired_model_name != test_model_name) {
-                    //this  can't be it--names  don't match
-                    //ROS_INFO("names don't match for i_des_part = %d, ipart_seen = %d", i_des_part, ipart_seen);
-                    i_des_part++;
-                } else {
-                    //OK--names match; how about coordinates?
-                    if (compare_pose(model_pose_from_image_wrt_world.pose, desired_model.pose)) {
-                        //found a match!
-                        //ROS_INFO("found match! i_des_part = %d, ipart_seen = %d", i_des_part, ipart_seen);
-                        found = true; //done considering precise match for this observed part; move along to next observed  part
-                        classified_observed_part[ipart_seen] = true;
-                        classified_desired_part[i_des_part] = true;
-                        satisfied_models_wrt_world.push_back(desired_model);
-                        part_indices_precisely_placed.push_back(i_des_part);
-                    } else {
-                        //nope--not a match; try next desired  part
-                        //ROS_INFO("names matched, but not coords for i_des_part = %d, ipart_seen = %d", i_des_part, ipart_seen);
-                        i_des_part++;
-                    }
-                }
-            }
-        }
-    }
-    ROS_INFO("found %d precise matches", (int) satisfied_models_wrt_world.size());
-
-    //remaining parts  seen are either misaligned or orphaned
-    ROS_INFO("seeking approximate matches");
-    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
-        //only consider observed parts not already classified
-        if (!classified_observed_part[ipart_seen]) {
-            //ROS_INFO("evaluating ipart_seen = %d", ipart_seen);
-            test_model = filtered_box_camera_image.models[ipart_seen];
-            string test_model_name(test_model.type);
-            model_pose_from_image_wrt_world = compute_stPose(filtered_box_camera_image.pose, test_model.pose);
-            int i_des_part = 0;
-            bool found = false;
-            while ((i_des_part < num_parts_desired)&&(!found)) {
-                if (!classified_desired_part[i_des_part]) {
-                    //step through all desired parts seeking a good match:
-                    desired_model = desired_models_wrt_world[i_des_part];
-                    string desired_model_name(desired_model.type);
-                    if (desired_model_name != test_model_name) {
-                        //this  can't be it--names  don't match
-                        i_des_part++;
-                    } else {
-                        //OK--names match; how about coordinates?
-                        if (compare_pose_approx(model_pose_from_image_wrt_world.pose, desired_model.pose)) {
-                            //ROS_INFO("found approx match for ipart_seen= %d, i_des_part= %d", ipart_seen, i_des_part);
-                            //found a match!
-                            found = true; //done considering precise match for this observed part; move along to next observed  part
-                            classified_observed_part[ipart_seen] = true;
-                            classified_desired_part[i_des_part] = true;
-                            misplaced_models_desired_coords_wrt_world.push_back(desired_model);
-                            test_model.pose = model_pose_from_image_wrt_world.pose;
-                            misplaced_models_actual_coords_wrt_world.push_back(test_model);
-                            part_indices_misplaced.push_back(i_des_part);
-                        } else {
-                            //nope--not a match; try next desired  part
-                            i_des_part++;
-                        }
-                    }
-                }
-                else  i_des_part++;
-            }
-        }
-        
-    }
-    ROS_INFO("found %d approximate matches", (int) misplaced_models_actual_coords_wrt_world.size());
-
-    //are there any stragglers?  If so, they are badly placed, or they are orphans
-    //ROS_INFO("checking for outliers");
-    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
-        //only consider observed parts not already classified
-        if (!classified_observed_part[ipart_seen]) {
-            test_model = filtered_box_camera_image.models[ipart_seen];
-            model_pose_from_image_wrt_world = compute_stPose(filtered_box_camera_image.pose, test_model.pose);
-
-            string test_model_name(test_model.type);
-            int i_des_part = 0;
-            bool found = false;
-            while ((i_des_part < num_parts_desired)&&(!found)) {
-                if (!classified_desired_part[i_des_part]) {
-                    //step through all desired parts seeking a good match:
-                    desired_model = desired_models_wrt_world[i_des_part];
-                    string desired_model_name(desired_model.type);
-                    if (desired_model_name == test_model_name) {
-                        //matched names of unclassified  parts; associate them
-                        found = true;
-                        classified_observed_part[ipart_seen] = true;
-                        classified_desired_part[i_des_part] = true;
-                        misplaced_models_desired_coords_wrt_world.push_back(desired_model);
-                        test_model.pose = model_pose_from_image_wrt_world.pose;
-                        misplaced_models_actual_coords_wrt_world.push_back(test_model);
-                        part_indices_misplaced.push_back(i_des_part);
-                    } else {
-                        i_des_part++;
-                    }
-
-                }
-                else i_des_part++;
-            }
-            //finished match search for this observed part; if no match, call  it an orphan
-            if (i_des_part >= num_parts_desired) {
-                //halting condition was end of list of desired  parts; therefore, this observed part is an orphan
-                classified_observed_part[ipart_seen] = true;
-                test_model.pose = model_pose_from_image_wrt_world.pose;
-                orphan_models_wrt_world.push_back(test_model);
-            }
-        }
-    }
-    
-    //by the time we are here, all parts should be classified
-    bool all_classified = true;
-    for (int i = 0; i < num_parts_seen; i++) all_classified &= classified_observed_part[i];
-    if (!all_classified) {
-        ROS_WARN("update_inspection: something is wrong; not all observed  parts are classified");
+    LATENCY_SCOPE("inspector/update_inspection");
+    if (!get_inspection_report(cam_num)) {
+        ROS_WARN("camera number not recognized in BoxInspector2::update_inspection");
         return false;
     }
-    
-    //now, all unclassified desired parts are missing:
-    for (int ipart=0;ipart<num_parts_desired;ipart++) {
-        if (!classified_desired_part[ipart]) {
-            //this part is not  classified,  so it's missing:
-            part_indices_missing.push_back(ipart);
-            desired_model = desired_models_wrt_world[ipart];
-            missing_models_wrt_world.push_back(desired_model);
-        }
+    osrf_gear::LogicalCameraImage filtered_box_camera_image;
+    //if blackout, DO NOT clear the model vectors!
+    if (!get_filtered_snapshots_from_box_cam(filtered_box_camera_image,cam_num)) {
+        return false;
     }
-    
-    
-    int n_orphaned = orphan_models_wrt_world.size();
-    int n_satisifed = satisfied_models_wrt_world.size();
-    int n_misplaced = misplaced_models_actual_coords_wrt_world.size();
-    //ROS_INFO("box inspection update results: ");
-    //ROS_INFO("num_parts_seen= %d; n_satisifed=%d; n_misplaced=%d; n_orphaned = %d", num_parts_seen, n_satisifed, n_misplaced, n_orphaned);
-    return true;
 
+    //classify into this station's report; every bad part reported by the quality sensor is an orphan;
+    // part types unchanged since the previous inspection reuse their pairing
+    const InspectionReport &report = classify_station(cam_num, filtered_box_camera_image, desired_models_wrt_world);
+    if (report.faulty.empty()) ROS_INFO("no bad parts reported by quality sensor %d",cam_num);
+
+    //OK--got an image; rebuild all model vectors from the report
+    gather_models(report.observed_models, report.orphans, orphan_models_wrt_world);
+    gather_models(desired_models_wrt_world, report.precisely_placed, satisfied_models_wrt_world);
+    gather_models(report.observed_models, report.misplaced_observed, misplaced_models_actual_coords_wrt_world);
+    gather_models(desired_models_wrt_world, report.misplaced, misplaced_models_desired_coords_wrt_world);
+    gather_models(desired_models_wrt_world, report.missing, missing_models_wrt_world);
+    part_indices_misplaced = report.misplaced;
+    part_indices_missing = report.missing;
+    part_indices_precisely_placed = report.precisely_placed;
+    return true;
 }
 
 //intent of this function: when holding a part above the (Q1) box, find the (filtered) pose of
@@ -842,11 +457,17 @@ bool BoxInspector2::get_grasped_part_pose_wrt_world(inventory_msgs::Part &observ
     double max_ht = 0.0; //BOX_SURFACE_HT_WRT_WORLD;
     
     bool found_a_candidate=false;        
+    PoseBatch pose_workspace;
+    vector<geometry_msgs::Pose> poses_wrt_world;
+    grasped_part_pose_wrt_world.header.stamp = compute_world_poses(filtered_box_camera_image, pose_workspace, poses_wrt_world);
+    grasped_part_pose_wrt_world.header.frame_id = "world";
+    vector<int> type_ids;
+    intern_part_types(filtered_box_camera_image.models, type_ids);
+    int grasped_type_id = g_part_types.find(grasped_part_name); //unknown if the camera never saw this type
     for (int i = 0; i < filtered_box_camera_image.models.size(); i++) {
-        string model_name(filtered_box_camera_image.models[i].type);
-        if (model_name==grasped_part_name) {
+        if (type_ids[i] == grasped_type_id) {
             found_a_candidate=true;
-            grasped_part_pose_wrt_world = compute_stPose(filtered_box_camera_image.pose, filtered_box_camera_image.models[i].pose);
+            grasped_part_pose_wrt_world.pose = poses_wrt_world[i];
             if (grasped_part_pose_wrt_world.pose.position.z > max_ht) {
                 max_ht = grasped_part_pose_wrt_world.pose.position.z;
                 //winner = i; //don't care which model wins; just copy over the pose
@@ -914,18 +535,12 @@ bool BoxInspector2::get_grasped_part_pose_wrt_world2(inventory_msgs::Part &obser
 bool BoxInspector2::get_box_pose_wrt_world(geometry_msgs::PoseStamped &box_pose_wrt_world, int cam_num) {
     geometry_msgs::Pose cam_pose, box_pose; //cam_pose is w/rt world, but box_pose is w/rt camera
     //default: assign assumed box pose until/unless get camera data
-    switch(cam_num) {
-        case CAM1:  
-            box_pose_wrt_world = NOM_BOX1_POSE_WRT_WORLD; //did not see box; use expected pose
-            break;
-        case CAM2:
-            box_pose_wrt_world = NOM_BOX2_POSE_WRT_WORLD; //did not see box; use expected pose
-            ROS_INFO("get_box_pose_wrt_world: nom assignment set for cam2");
-            break;
-        default:
-            ROS_WARN("get_box_pose_wrt_world: cam_num %d not recognized! ",cam_num);
-            return false;
+    const InspectionStationConfig *station = inspection_station_config(cam_num);
+    if (!station) {
+        ROS_WARN("get_box_pose_wrt_world: cam_num %d not recognized! ",cam_num);
+        return false;
     }
+    box_pose_wrt_world = nominal_box_pose(*station); //did not see box; use expected pose
     
 
     //get a new (filtered) snapshot of the box-inspection camera:
@@ -941,14 +556,11 @@ bool BoxInspector2::get_box_pose_wrt_world(geometry_msgs::PoseStamped &box_pose_
     int num_models = filtered_box_camera_image.models.size(); //how many models did the camera see?
     //ROS_INFO("num models seen = %d",num_models);
     if (num_models == 0) return false;
-    string box_name("shipping_box"); //does a model match this name?
-    osrf_gear::Model model;
     cam_pose = filtered_box_camera_image.pose;
     //ROS_INFO("box cam sees %d models", num_models);
     for (int imodel = 0; imodel < num_models; imodel++) {
-        model = filtered_box_camera_image.models[imodel];
-        string model_name(model.type);
-        if (model_name == box_name) {
+        const osrf_gear::Model &model = filtered_box_camera_image.models[imodel];
+        if (g_part_types.intern(model.type) == SHIPPING_BOX_TYPE_ID) {
             box_pose = model.pose;
             ROS_INFO_STREAM("get_box_pose_wrt_world(): found box at pose " << box_pose << endl);
 
@@ -1011,6 +623,7 @@ geometry_msgs::PoseStamped BoxInspector2::compute_stPose(geometry_msgs::Pose cam
 
     geometry_msgs::PoseStamped stPose_part_wrt_world;
     //compute part-pose w/rt world and return as a pose-stamped message object
+    //for all models of an image at once, prefer compute_world_poses() (box_inspector_pose_utils.cpp)
     Eigen::Affine3d cam_wrt_world, part_wrt_cam, part_wrt_world;
 
     cam_wrt_world = xformUtils_.transformPoseToEigenAffine3d(cam_pose);
@@ -0,0 +1,72 @@
+//box_inspector2_ext.h: free-function companions to class BoxInspector2
+//these are implemented in box_inspector2.cpp (and the files it includes); they operate on
+// per-station state kept alongside the BoxInspector2 object
+#ifndef BOX_INSPECTOR2_EXT_H
+#define BOX_INSPECTOR2_EXT_H
+
+#include <box_inspector/box_inspector2.h>
+#include "box_inspector_core.h"
+#include <string>
+#include <vector>
+
+//result of one box inspection; rather than copying models into a vector per category, each category (see
+// ClassificationResult) is an index list into observed_models (the report's own pooled store) or into the
+// desired-model list that was inspected against; reusing a report across inspections does not reallocate
+// once it has grown
+struct InspectionReport : ClassificationResult {
+    std::vector<osrf_gear::Model> observed_models; //every model the camera saw, poses w/rt world
+};
+
+//everything that distinguishes one inspection station from another; stations are numbered by their
+// box camera, 1..num_inspection_stations()
+struct InspectionStationConfig {
+    const char *name; //e.g. "Q1"
+    int cam_num;
+    const char *box_camera_topic;
+    const char *quality_sensor_topic;
+    unsigned short int location_code; //inventory_msgs::Part::location of parts in a box at this station
+    double nom_box_x, nom_box_y, nom_box_z; //nominal box position w/rt world; box is nominally unrotated
+};
+
+int num_inspection_stations();
+
+//NULL if cam_num is not recognized
+const InspectionStationConfig *inspection_station_config(int cam_num);
+
+//startup readiness: the BoxInspector2 constructor subscribes and returns at once; a station is ready once
+// its box camera and its quality sensor have each delivered a message; until then, inspections at that
+// station wait for their sensors (with the usual timeouts)
+bool box_camera_ready(int cam_num);
+bool quality_sensor_ready(int cam_num);
+bool inspection_station_ready(int cam_num);
+
+//block until every station is ready, or for at most timeout (seconds); returns false, and warns about
+// each sensor still silent, on timeout
+bool wait_for_inspection_stations(double timeout);
+
+//every faulty part currently reported by station cam_num's quality sensor, poses w/rt world; uses the
+// latest reading if fresh (see get_bad_part_Q()), else waits for the next one; returns false on timeout
+// or if cam_num is not recognized
+bool get_faulty_parts(int cam_num, std::vector<inventory_msgs::Part> &faulty_parts);
+
+//the report produced by the most recent inspection at station cam_num (by update_inspection() or any of
+// its wrappers); NULL if cam_num is not recognized
+const InspectionReport *get_inspection_report(int cam_num);
+
+//tell the inspector that the robot just picked, placed, moved or discarded a part of this type
+// at station cam_num; the next update_inspection() re-matches this type even if its observed parts
+// appear unchanged, while all other part types reuse their previous classification; box-camera frames and
+// quality-sensor readings received before this call are no longer used, so the next inspection sees only
+// the box after the action
+void note_box_action(int cam_num, const std::string &part_type);
+
+//same result as inspector.compute_shipment_poses_wrt_world(), but the shipment is converted to poses w/rt
+// its box only the first time it is seen; after that, only the box pose is applied (in one batch)
+void compute_shipment_poses_from_template(BoxInspector2 &inspector, const osrf_gear::Shipment &shipment,
+        const geometry_msgs::PoseStamped &box_pose_wrt_world, std::vector<osrf_gear::Model> &desired_models_wrt_world);
+
+//forget all previous classification state for a station, e.g. when a new box arrives; box-camera frames
+// and quality-sensor readings received before this call are no longer used
+void reset_inspection_cache(int cam_num);
+
+#endif
@@ -0,0 +1,306 @@
+//box_inspector_bench.cpp: microbenchmarks for the box-inspection hot path
+//drives the inspector's classification logic (box_inspector_matching.cpp, and the ROS-free core it wraps,
+// box_inspector_core.cpp), pose comparison, camera-to-world transforms and the multi-frame snapshot filter
+// from synthetic LogicalCameraImage fixtures, 1 to hundreds of parts, with duplicate part types and faulty
+// parts; no BoxInspector2 object is constructed, so neither Gazebo nor a ROS master is needed
+//reports, per benchmark: ns per call, heap allocations per call, and items (parts or poses) per second
+//build (in a catkin workspace with the box_inspector package) as its own executable, e.g.:
+//  add_executable(box_inspector_bench src/box_inspector_bench.cpp)
+//  target_link_libraries(box_inspector_bench ${catkin_LIBRARIES})
+//run: box_inspector_bench [name_filter] [--min_time=<sec>]
+
+#include "box_inspector2.cpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+//allocation counting: every operator new in the process is counted
+std::atomic<unsigned long> g_n_allocations(0);
+
+//new and delete are kept out of line, so the compiler does not see them pair malloc with free
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    g_n_allocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+__attribute__((noinline)) void operator delete(void *p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, std::size_t) noexcept {
+    free(p);
+}
+
+double g_min_bench_time = 0.2; //(sec) each benchmark runs at least this long
+
+//run body() repeatedly, doubling the iteration count until the run lasts g_min_bench_time, and report the
+// last run; items_per_call is the number of parts (or poses) one call handles
+template <typename Body>
+void run_benchmark(const std::string &name, const std::string &filter, int items_per_call, Body body) {
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+    body(); //warm-up: grows workspaces and caches to steady state
+    long n_iterations = 1;
+    double elapsed = 0.0;
+    unsigned long n_allocations = 0;
+    while (true) {
+        unsigned long allocations_before = g_n_allocations.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < n_iterations; i++) body();
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        n_allocations = g_n_allocations.load(std::memory_order_relaxed) - allocations_before;
+        if (elapsed >= g_min_bench_time || n_iterations >= (1L << 30)) break;
+        n_iterations *= 2;
+    }
+    double ns_per_call = 1e9 * elapsed / n_iterations;
+    printf("%-44s %12.0f ns/call %10.1f allocs/call %14.0f items/s\n", name.c_str(), ns_per_call,
+            (double) n_allocations / n_iterations, items_per_call * n_iterations / elapsed);
+}
+
+//fixtures:
+const char *BENCH_PART_TYPES[] = {"piston_rod_part", "gear_part", "pulley_part", "gasket_part", "disk_part"};
+const int N_BENCH_PART_TYPES = 5;
+
+double uniform(double lo, double hi) {
+    return lo + (hi - lo) * (rand() / (double) RAND_MAX);
+}
+
+geometry_msgs::Pose random_pose(double yaw_range) {
+    geometry_msgs::Pose pose;
+    pose.position.x = uniform(-0.3, 0.3);
+    pose.position.y = uniform(-0.2, 0.2);
+    pose.position.z = uniform(0.5, 0.6);
+    double yaw = uniform(-yaw_range, yaw_range);
+    pose.orientation.z = sin(0.5 * yaw);
+    pose.orientation.w = cos(0.5 * yaw);
+    return pose;
+}
+
+//perturb a pose by up to position_noise (m) in x, y and yaw_noise (rad) about z
+geometry_msgs::Pose perturbed(const geometry_msgs::Pose &pose, double position_noise, double yaw_noise) {
+    geometry_msgs::Pose out = pose;
+    out.position.x += uniform(-position_noise, position_noise);
+    out.position.y += uniform(-position_noise, position_noise);
+    double half_yaw = 0.5 * uniform(-yaw_noise, yaw_noise);
+    double c = cos(half_yaw), s = sin(half_yaw);
+    geometry_msgs::Quaternion q = pose.orientation;
+    out.orientation.x = c * q.x - s * q.y;
+    out.orientation.y = c * q.y + s * q.x;
+    out.orientation.z = c * q.z + s * q.w;
+    out.orientation.w = c * q.w - s * q.z;
+    return out;
+}
+
+//a box-camera image of n_parts parts (types repeat, so most types have duplicates) plus the shipping box,
+// and a desired shipment for it: ~70% of parts precisely placed, ~15% misplaced, the rest orphans, ~5% of
+// the placed parts faulty, and one desired part per 8 observed parts missing
+struct InspectionFixture {
+    osrf_gear::LogicalCameraImage image; //coords w/rt camera
+    vector<osrf_gear::Model> desired_models_wrt_world;
+    vector<inventory_msgs::Part> faulty_parts;
+};
+
+void make_inspection_fixture(int n_parts, InspectionFixture &fixture) {
+    srand(n_parts);
+    fixture.image.models.clear();
+    fixture.desired_models_wrt_world.clear();
+    fixture.faulty_parts.clear();
+    fixture.image.pose.position.x = 0.6;
+    fixture.image.pose.position.y = 0.5;
+    fixture.image.pose.position.z = 1.8;
+    fixture.image.pose.orientation.y = 0.7071068; //looking down
+    fixture.image.pose.orientation.w = 0.7071068;
+    osrf_gear::Model box;
+    box.type = "shipping_box";
+    box.pose = random_pose(0.1);
+    fixture.image.models.push_back(box);
+    for (int i = 0; i < n_parts; i++) {
+        osrf_gear::Model model;
+        model.type = BENCH_PART_TYPES[i % N_BENCH_PART_TYPES];
+        model.pose = random_pose(M_PI);
+        fixture.image.models.push_back(model);
+    }
+    //desired poses are derived from the observed poses w/rt world
+    PoseBatch workspace;
+    vector<geometry_msgs::Pose> poses_wrt_world;
+    compute_world_poses(fixture.image, workspace, poses_wrt_world);
+    for (int i = 1; i <= n_parts; i++) {
+        double category = uniform(0.0, 1.0);
+        osrf_gear::Model desired;
+        desired.type = fixture.image.models[i].type;
+        if (category < 0.70) {
+            desired.pose = perturbed(poses_wrt_world[i], 0.005, 0.02); //precise
+        } else if (category < 0.85) {
+            desired.pose = perturbed(poses_wrt_world[i], 0.05, 0.5); //misplaced
+        } else {
+            continue; //orphan
+        }
+        fixture.desired_models_wrt_world.push_back(desired);
+        if (uniform(0.0, 1.0) < 0.05) {
+            inventory_msgs::Part faulty;
+            faulty.name = fixture.image.models[i].type;
+            faulty.pose.pose = poses_wrt_world[i];
+            fixture.faulty_parts.push_back(faulty);
+        }
+    }
+    for (int i = 0; i < (n_parts + 7) / 8; i++) {
+        osrf_gear::Model missing;
+        missing.type = BENCH_PART_TYPES[i % N_BENCH_PART_TYPES];
+        missing.pose = random_pose(M_PI);
+        missing.pose.position.x += 2.0; //nowhere near any observed part
+        fixture.desired_models_wrt_world.push_back(missing);
+    }
+}
+
+//n_frames noisy copies of an image, as the box camera delivers them
+void make_frames(const osrf_gear::LogicalCameraImage &image, int n_frames, vector<osrf_gear::LogicalCameraImage> &frames) {
+    frames.assign(n_frames, image);
+    for (int f = 0; f < n_frames; f++) {
+        for (int i = 0; i < (int) frames[f].models.size(); i++) {
+            frames[f].models[i].pose = perturbed(image.models[i].pose, 0.002, 0.005);
+        }
+    }
+}
+
+//the Eigen-based pose comparison this tree used before pose_within_tolerance(), kept as the reference
+XformUtils g_xform_utils;
+
+bool compare_pose_eigen(const geometry_msgs::Pose &pose_A, const geometry_msgs::Pose &pose_B) {
+    Eigen::Affine3d affine1 = g_xform_utils.transformPoseToEigenAffine3d(pose_A);
+    Eigen::Affine3d affine2 = g_xform_utils.transformPoseToEigenAffine3d(pose_B);
+    double origin_err = (affine1.translation() - affine2.translation()).norm();
+    Eigen::Matrix3d R_diff = affine1.linear().inverse() * affine2.linear();
+    Eigen::AngleAxisd angleAxis(R_diff);
+    return origin_err < ORIGIN_ERR_TOL && angleAxis.angle() < ORIENTATION_ERR_TOL;
+}
+
+//the per-model camera-to-world transform compute_stPose() does, without the BoxInspector2 object
+geometry_msgs::Pose compute_stPose_eigen(const geometry_msgs::Pose &cam_pose, const geometry_msgs::Pose &part_pose) {
+    Eigen::Affine3d cam_wrt_world = g_xform_utils.transformPoseToEigenAffine3d(cam_pose);
+    Eigen::Affine3d part_wrt_cam = g_xform_utils.transformPoseToEigenAffine3d(part_pose);
+    return g_xform_utils.transformEigenAffine3dToPose(cam_wrt_world * part_wrt_cam);
+}
+
+volatile int g_sink; //keeps results from being optimized away
+
+int main(int argc, char** argv) {
+    std::string filter;
+    const std::string min_time_flag("--min_time=");
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, min_time_flag.size(), min_time_flag) == 0) {
+            g_min_bench_time = atof(arg.substr(min_time_flag.size()).c_str());
+        } else {
+            filter = arg;
+        }
+    }
+    ros::Time::init(); //ros::Time::now() without a ROS master
+
+    const int PART_COUNTS[] = {1, 4, 16, 64, 256};
+    const int N_PART_COUNTS = 5;
+    InspectionFixture fixture;
+    char name[64];
+    for (int ic = 0; ic < N_PART_COUNTS; ic++) {
+        int n_parts = PART_COUNTS[ic];
+        make_inspection_fixture(n_parts, fixture);
+        InspectionWorkspace workspace;
+        InspectionReport report;
+
+        sprintf(name, "classify/uncached/%d", n_parts);
+        run_benchmark(name, filter, n_parts, [&]() {
+            classify_box_contents(fixture.image, fixture.desired_models_wrt_world, &fixture.faulty_parts, NULL,
+                    workspace, report);
+            g_sink = report.orphans.size();
+        });
+
+        //steady state between robot actions: nothing changed since the previous inspection
+        StationMatchCache cache;
+        sprintf(name, "classify/cached/%d", n_parts);
+        run_benchmark(name, filter, n_parts, [&]() {
+            classify_box_contents(fixture.image, fixture.desired_models_wrt_world, &fixture.faulty_parts, &cache,
+                    workspace, report);
+            g_sink = report.orphans.size();
+        });
+
+        //the robot just acted on one part type, which is re-matched
+        const std::string &acted_type = fixture.image.models[1].type;
+        sprintf(name, "classify/cached_one_type_dirty/%d", n_parts);
+        run_benchmark(name, filter, n_parts, [&]() {
+            mark_type_dirty(cache, g_part_types.find(acted_type));
+            classify_box_contents(fixture.image, fixture.desired_models_wrt_world, &fixture.faulty_parts, &cache,
+                    workspace, report);
+            g_sink = report.orphans.size();
+        });
+
+        //the ROS-free core alone, on the plain data the adapter above converted the fixture to
+        ClassificationWorkspace core_workspace;
+        ClassificationResult core_result;
+        sprintf(name, "classify/core_uncached/%d", n_parts);
+        run_benchmark(name, filter, n_parts, [&]() {
+            classify_parts(workspace.observed_type_ids, workspace.observed_poses, workspace.desired_type_ids,
+                    workspace.desired_poses, workspace.faulty_poses, g_pose_tolerances, NULL, core_workspace, core_result);
+            g_sink = core_result.orphans.size();
+        });
+
+        //camera-to-world transform of every model in an image
+        int n_models = fixture.image.models.size();
+        vector<geometry_msgs::Pose> poses_wrt_world(n_models);
+        sprintf(name, "world_poses/compute_stPose/%d", n_parts);
+        run_benchmark(name, filter, n_models, [&]() {
+            for (int i = 0; i < n_models; i++) {
+                poses_wrt_world[i] = compute_stPose_eigen(fixture.image.pose, fixture.image.models[i].pose);
+            }
+            g_sink = poses_wrt_world.size();
+        });
+        PoseBatch pose_batch;
+        sprintf(name, "world_poses/batched/%d", n_parts);
+        run_benchmark(name, filter, n_models, [&]() {
+            compute_world_poses(fixture.image, pose_batch, poses_wrt_world);
+            g_sink = poses_wrt_world.size();
+        });
+
+        //snapshot filter: fuse 4 frames, as get_filtered_snapshots_from_box_cam() does
+        vector<osrf_gear::LogicalCameraImage> frames;
+        make_frames(fixture.image, 4, frames);
+        vector<const osrf_gear::LogicalCameraImage *> frame_ptrs;
+        for (int f = 0; f < (int) frames.size(); f++) frame_ptrs.push_back(&frames[f]);
+        osrf_gear::LogicalCameraImage fused_image;
+        sprintf(name, "snapshot_filter/4_frames/%d", n_parts);
+        run_benchmark(name, filter, n_models, [&]() {
+            fuse_box_cam_frames(frame_ptrs, fused_image);
+            g_sink = fused_image.models.size();
+        });
+    }
+
+    //pose comparison, old and new, over pairs near the tolerance boundary
+    const int N_POSE_PAIRS = 1024;
+    vector<geometry_msgs::Pose> poses_A(N_POSE_PAIRS), poses_B(N_POSE_PAIRS);
+    srand(1);
+    for (int i = 0; i < N_POSE_PAIRS; i++) {
+        poses_A[i] = random_pose(M_PI);
+        poses_B[i] = perturbed(poses_A[i], 0.03, 0.15);
+    }
+    int n_disagreements = 0;
+    for (int i = 0; i < N_POSE_PAIRS; i++) {
+        if (compare_pose_eigen(poses_A[i], poses_B[i]) != pose_within_tolerance(poses_A[i], poses_B[i], g_pose_tolerances.precise)) {
+            n_disagreements++;
+        }
+    }
+    run_benchmark("compare_pose/eigen", filter, N_POSE_PAIRS, [&]() {
+        int n_within = 0;
+        for (int i = 0; i < N_POSE_PAIRS; i++) n_within += compare_pose_eigen(poses_A[i], poses_B[i]);
+        g_sink = n_within;
+    });
+    run_benchmark("compare_pose/quaternion", filter, N_POSE_PAIRS, [&]() {
+        int n_within = 0;
+        for (int i = 0; i < N_POSE_PAIRS; i++) {
+            n_within += pose_within_tolerance(poses_A[i], poses_B[i], g_pose_tolerances.precise);
+        }
+        g_sink = n_within;
+    });
+    printf("compare_pose: eigen and quaternion versions disagree on %d of %d pairs\n", n_disagreements, N_POSE_PAIRS);
+    return 0;
+}
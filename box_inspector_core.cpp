@@ -0,0 +1,503 @@
+//box_inspector_core.cpp: implementation of box_inspector_core.h
+//included by box_inspector2.cpp; needs nothing but the standard library, so an offline program can
+// include (or compile) it on its own
+#include "box_inspector_core.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using std::vector;
+
+//pose tolerances:
+void PoseTolerance::set(double origin_err_tol, double orientation_err_tol) {
+    origin_err_tol_sq = origin_err_tol*origin_err_tol;
+    double cos_half = cos(0.5 * orientation_err_tol);
+    cos_sq_half_orientation_tol = (orientation_err_tol >= M_PI) ? -1.0 : cos_half*cos_half;
+}
+
+bool pose_within_tolerance(const PlainPose &pose_A, const PlainPose &pose_B, const PoseTolerance &tolerance) {
+    double dx = pose_A.x - pose_B.x;
+    double dy = pose_A.y - pose_B.y;
+    double dz = pose_A.z - pose_B.z;
+    if (dx * dx + dy * dy + dz * dz >= tolerance.origin_err_tol_sq) return false; //cheap test first
+    double dot = pose_A.qx * pose_B.qx + pose_A.qy * pose_B.qy + pose_A.qz * pose_B.qz + pose_A.qw * pose_B.qw;
+    double norm_sq_A = pose_A.qx * pose_A.qx + pose_A.qy * pose_A.qy + pose_A.qz * pose_A.qz + pose_A.qw * pose_A.qw;
+    double norm_sq_B = pose_B.qx * pose_B.qx + pose_B.qy * pose_B.qy + pose_B.qz * pose_B.qz + pose_B.qw * pose_B.qw;
+    return dot * dot > tolerance.cos_sq_half_orientation_tol * norm_sq_A * norm_sq_B;
+}
+
+//multi-frame pose fusion:
+const double FUSION_ASSOCIATION_RADIUS = 0.05; //(m) max apparent motion of a model between frames
+const double FUSION_OUTLIER_THRESHOLD = 3.0; //reject samples beyond this many robust std devs from the median
+const double FUSION_MIN_POSITION_SIGMA = 0.002; //(m) floor on robust std dev; avoids rejecting plain sensor noise
+const double FUSION_MIN_ANGLE_SIGMA = 0.01; //(rad)
+const double MAD_TO_SIGMA = 1.4826; //scale of median absolute deviation to std dev, for gaussian noise
+
+double median_of(vector<double> values) {
+    int n = values.size();
+    if (n == 0) return 0.0;
+    std::nth_element(values.begin(), values.begin() + n / 2, values.end());
+    double upper = values[n / 2];
+    if (n % 2) return upper;
+    double lower = *std::max_element(values.begin(), values.begin() + n / 2);
+    return 0.5 * (lower + upper);
+}
+
+double quat_dot(const PlainPose &a, const PlainPose &b) {
+    return a.qx * b.qx + a.qy * b.qy + a.qz * b.qz + a.qw * b.qw;
+}
+
+double quat_angle(const PlainPose &a, const PlainPose &b) {
+    double abs_dot = fabs(quat_dot(a, b));
+    if (abs_dot > 1.0) abs_dot = 1.0;
+    return 2.0 * acos(abs_dot);
+}
+
+//flags samples whose values lie within FUSION_OUTLIER_THRESHOLD robust std devs of the median
+void flag_inliers(const vector<double> &values, double min_sigma, vector<bool> &inlier) {
+    double median = median_of(values);
+    vector<double> abs_dev(values.size());
+    for (int i = 0; i < (int) values.size(); i++) abs_dev[i] = fabs(values[i] - median);
+    double sigma = std::max(MAD_TO_SIGMA * median_of(abs_dev), min_sigma);
+    for (int i = 0; i < (int) values.size(); i++) {
+        if (abs_dev[i] > FUSION_OUTLIER_THRESHOLD * sigma) inlier[i] = false;
+    }
+}
+
+//positions are rejected by distance from the component-wise median, orientations by angle from the
+// reference; survivors are averaged, with quaternions flipped into the reference's hemisphere first
+PlainPose fuse_pose_samples(const vector<PlainPose> &samples) {
+    int n_samples = samples.size();
+    vector<double> xs(n_samples), ys(n_samples), zs(n_samples);
+    for (int i = 0; i < n_samples; i++) {
+        xs[i] = samples[i].x;
+        ys[i] = samples[i].y;
+        zs[i] = samples[i].z;
+    }
+    double x_med = median_of(xs), y_med = median_of(ys), z_med = median_of(zs);
+    //reference orientation: the sample nearest the median position
+    vector<double> dists(n_samples), angles(n_samples);
+    int i_ref = 0;
+    for (int i = 0; i < n_samples; i++) {
+        double dx = xs[i] - x_med, dy = ys[i] - y_med, dz = zs[i] - z_med;
+        dists[i] = sqrt(dx * dx + dy * dy + dz * dz);
+        if (dists[i] < dists[i_ref]) i_ref = i;
+    }
+    const PlainPose &reference = samples[i_ref];
+    for (int i = 0; i < n_samples; i++) angles[i] = quat_angle(samples[i], reference);
+
+    vector<bool> inlier(n_samples, true);
+    if (n_samples >= 3) { //w/ fewer samples, can't tell which one is the outlier
+        flag_inliers(dists, FUSION_MIN_POSITION_SIGMA, inlier);
+        flag_inliers(angles, FUSION_MIN_ANGLE_SIGMA, inlier);
+    }
+    inlier[i_ref] = true; //never end up with an empty set
+
+    PlainPose fused;
+    fused.qw = 0.0; //accumulator
+    int n_inliers = 0;
+    for (int i = 0; i < n_samples; i++) {
+        if (!inlier[i]) continue;
+        n_inliers++;
+        const PlainPose &sample = samples[i];
+        fused.x += sample.x;
+        fused.y += sample.y;
+        fused.z += sample.z;
+        double sign = (quat_dot(sample, reference) < 0.0) ? -1.0 : 1.0; //q and -q: same rotation
+        fused.qx += sign * sample.qx;
+        fused.qy += sign * sample.qy;
+        fused.qz += sign * sample.qz;
+        fused.qw += sign * sample.qw;
+    }
+    fused.x /= n_inliers;
+    fused.y /= n_inliers;
+    fused.z /= n_inliers;
+    double quat_norm = sqrt(quat_dot(fused, fused));
+    fused.qx /= quat_norm;
+    fused.qy /= quat_norm;
+    fused.qz /= quat_norm;
+    fused.qw /= quat_norm;
+    return fused;
+}
+
+void fuse_frames(const vector<const vector<PlainModel> *> &frames, vector<PlainPose> &fused_poses) {
+    const vector<PlainModel> &reference = *frames[0];
+    int num_models = reference.size();
+    int n_frames = frames.size();
+    vector<vector<PlainPose> > samples(num_models);
+    for (int j = 0; j < num_models; j++) samples[j].push_back(reference[j].pose);
+
+    vector<bool> claimed;
+    for (int i = 1; i < n_frames; i++) {
+        const vector<PlainModel> &models = *frames[i];
+        claimed.assign(models.size(), false);
+        for (int j = 0; j < num_models; j++) {
+            const PlainModel &ref_model = reference[j];
+            int i_best = -1;
+            double best_dist_sq = FUSION_ASSOCIATION_RADIUS*FUSION_ASSOCIATION_RADIUS;
+            for (int k = 0; k < (int) models.size(); k++) {
+                if (claimed[k] || models[k].type_id != ref_model.type_id) continue;
+                double dx = models[k].pose.x - ref_model.pose.x;
+                double dy = models[k].pose.y - ref_model.pose.y;
+                double dz = models[k].pose.z - ref_model.pose.z;
+                double dist_sq = dx * dx + dy * dy + dz * dz;
+                if (dist_sq < best_dist_sq) {
+                    best_dist_sq = dist_sq;
+                    i_best = k;
+                }
+            }
+            if (i_best >= 0) {
+                claimed[i_best] = true;
+                samples[j].push_back(models[i_best].pose);
+            }
+        }
+    }
+    fused_poses.resize(num_models);
+    for (int j = 0; j < num_models; j++) fused_poses[j] = fuse_pose_samples(samples[j]);
+}
+
+//batched rigid transforms:
+void transform_pose_batch(const PlainPose &frame_pose, const PoseBatch &poses_in_frame, PoseBatch &poses_out) {
+    int n = poses_in_frame.size();
+    poses_out.resize(n);
+    if (n == 0) return;
+    //frame rotation, normalized once and expanded to a matrix for rotating positions
+    double q_norm = sqrt(quat_dot(frame_pose, frame_pose));
+    double ax = frame_pose.qx / q_norm, ay = frame_pose.qy / q_norm, az = frame_pose.qz / q_norm, aw = frame_pose.qw / q_norm;
+    double r00 = 1 - 2 * (ay * ay + az * az), r01 = 2 * (ax * ay - az * aw), r02 = 2 * (ax * az + ay * aw);
+    double r10 = 2 * (ax * ay + az * aw), r11 = 1 - 2 * (ax * ax + az * az), r12 = 2 * (ay * az - ax * aw);
+    double r20 = 2 * (ax * az - ay * aw), r21 = 2 * (ay * az + ax * aw), r22 = 1 - 2 * (ax * ax + ay * ay);
+    double tx = frame_pose.x, ty = frame_pose.y, tz = frame_pose.z;
+
+    const double *px = &poses_in_frame.px[0], *py = &poses_in_frame.py[0], *pz = &poses_in_frame.pz[0];
+    const double *bx = &poses_in_frame.qx[0], *by = &poses_in_frame.qy[0];
+    const double *bz = &poses_in_frame.qz[0], *bw = &poses_in_frame.qw[0];
+    double *ox = &poses_out.px[0], *oy = &poses_out.py[0], *oz = &poses_out.pz[0];
+    double *oqx = &poses_out.qx[0], *oqy = &poses_out.qy[0], *oqz = &poses_out.qz[0], *oqw = &poses_out.qw[0];
+    for (int i = 0; i < n; i++) {
+        double x = px[i], y = py[i], z = pz[i];
+        ox[i] = tx + r00 * x + r01 * y + r02 * z;
+        oy[i] = ty + r10 * x + r11 * y + r12 * z;
+        oz[i] = tz + r20 * x + r21 * y + r22 * z;
+        //quaternion product a*b
+        double qbx = bx[i], qby = by[i], qbz = bz[i], qbw = bw[i];
+        oqx[i] = aw * qbx + ax * qbw + ay * qbz - az * qby;
+        oqy[i] = aw * qby - ax * qbz + ay * qbw + az * qbx;
+        oqz[i] = aw * qbz + ax * qby - ay * qbx + az * qbw;
+        oqw[i] = aw * qbw - ax * qbx - ay * qby - az * qbz;
+    }
+}
+
+//matching:
+//cost tiers for the assignment: any precise match beats any approximate match, which beats
+// any name-only match; pose errors (meters + radians) are far smaller than the tier gaps
+const double MATCH_COST_APPROX = 1.0e3;
+const double MATCH_COST_NAME_ONLY = 1.0e6;
+const double MATCH_COST_RAD_TO_M = 0.1; //weight of orientation error relative to origin error
+
+//incremental inspection: the classification of each part type is cached per station, and reused
+// when none of that type's observed parts moved by more than these amounts since the last inspection
+const double INCREMENTAL_ORIGIN_TOL = 0.005; //(m)
+const double INCREMENTAL_ORIENTATION_TOL = 0.02; //(rad)
+
+void mark_type_dirty(StationMatchCache &cache, int type_id) {
+    if (type_id < 0) return;
+    if (type_id >= (int) cache.dirty_types.size()) cache.dirty_types.resize(type_id + 1, 0);
+    cache.dirty_types[type_id] = 1;
+}
+
+void reset_match_cache(StationMatchCache &cache) {
+    cache.generation += 2; //no entry is from the previous inspection any more
+    std::fill(cache.dirty_types.begin(), cache.dirty_types.end(), 0);
+}
+
+bool same_pose(const PlainPose &pose_A, const PlainPose &pose_B) {
+    return pose_A.x == pose_B.x && pose_A.y == pose_B.y && pose_A.z == pose_B.z && pose_A.qx == pose_B.qx
+            && pose_A.qy == pose_B.qy && pose_A.qz == pose_B.qz && pose_A.qw == pose_B.qw;
+}
+
+//can the cached assignment be reused for this bucket?  if so, cached_for_current[k] is the cached observed
+// index corresponding to current observed part k; observed parts are allowed to come in a different order
+bool bucket_unchanged(const TypeMatchCache &cached,
+        const vector<PlainPose> &observed_poses_wrt_world, const vector<int> &observed_idx,
+        const vector<PlainPose> &desired_poses_wrt_world, const vector<int> &desired_idx,
+        MatchScratch &scratch) {
+    static const PoseTolerance unchanged_tolerance(INCREMENTAL_ORIGIN_TOL, INCREMENTAL_ORIENTATION_TOL);
+    int n_observed = observed_idx.size();
+    if ((int) cached.observed_poses.size() != n_observed || cached.desired_poses.size() != desired_idx.size()) return false;
+    for (int i = 0; i < (int) desired_idx.size(); i++) {
+        if (!same_pose(cached.desired_poses[i], desired_poses_wrt_world[desired_idx[i]])) return false;
+    }
+    scratch.cached_for_current.assign(n_observed, -1);
+    scratch.claimed.assign(n_observed, 0);
+    for (int k = 0; k < n_observed; k++) {
+        const PlainPose &observed_pose = observed_poses_wrt_world[observed_idx[k]];
+        for (int c = 0; c < n_observed && scratch.cached_for_current[k] < 0; c++) {
+            if (!scratch.claimed[c] && pose_within_tolerance(observed_pose, cached.observed_poses[c], unchanged_tolerance)) {
+                scratch.claimed[c] = 1;
+                scratch.cached_for_current[k] = c;
+            }
+        }
+        if (scratch.cached_for_current[k] < 0) return false; //this part appeared or moved
+    }
+    return true;
+}
+
+//record a bucket's poses in its cache entry
+void store_bucket(TypeMatchCache &entry,
+        const vector<PlainPose> &observed_poses_wrt_world, const vector<int> &observed_idx,
+        const vector<PlainPose> &desired_poses_wrt_world, const vector<int> &desired_idx) {
+    entry.observed_poses.resize(observed_idx.size());
+    for (int k = 0; k < (int) observed_idx.size(); k++) entry.observed_poses[k] = observed_poses_wrt_world[observed_idx[k]];
+    entry.desired_poses.resize(desired_idx.size());
+    for (int k = 0; k < (int) desired_idx.size(); k++) entry.desired_poses[k] = desired_poses_wrt_world[desired_idx[k]];
+}
+
+//classify an already-paired observed/desired couple
+int match_tier(const PlainPose &observed_pose, const PlainPose &desired_pose, const PoseToleranceProfile &tolerances) {
+    if (pose_within_tolerance(observed_pose, desired_pose, tolerances.precise)) return MATCH_PRECISE;
+    if (pose_within_tolerance(observed_pose, desired_pose, tolerances.approx)) return MATCH_APPROX;
+    return MATCH_NAME_ONLY;
+}
+
+bool part_match_by_desired_index(const PartMatch &a, const PartMatch &b) {
+    return a.i_desired < b.i_desired;
+}
+
+//origin error (m) plus weighted rotation angle (rad) between two poses; tie-breaker within a tier
+double pose_error_cost(const PlainPose &pose_A, const PlainPose &pose_B) {
+    double dx = pose_A.x - pose_B.x;
+    double dy = pose_A.y - pose_B.y;
+    double dz = pose_A.z - pose_B.z;
+    return sqrt(dx * dx + dy * dy + dz * dz) + MATCH_COST_RAD_TO_M*quat_angle(pose_A, pose_B);
+}
+
+//Hungarian method (potentials + shortest augmenting paths), O(n_rows^2 * n_cols)
+//on return, row_to_col[i] is the column assigned to row i
+void solve_assignment(const vector<double> &cost, int n_rows, int n_cols, vector<int> &row_to_col,
+        AssignmentScratch &scratch) {
+    const double INF = std::numeric_limits<double>::infinity();
+    //1-based bookkeeping; col_to_row[0] is the row currently being inserted
+    vector<double> &u = scratch.u, &v = scratch.v, &min_slack = scratch.min_slack;
+    vector<int> &col_to_row = scratch.col_to_row, &way = scratch.way;
+    vector<char> &used = scratch.used;
+    u.assign(n_rows + 1, 0.0);
+    v.assign(n_cols + 1, 0.0);
+    min_slack.resize(n_cols + 1);
+    col_to_row.assign(n_cols + 1, 0);
+    way.assign(n_cols + 1, 0);
+    used.resize(n_cols + 1);
+    for (int i = 1; i <= n_rows; i++) {
+        col_to_row[0] = i;
+        int j0 = 0;
+        std::fill(min_slack.begin(), min_slack.end(), INF);
+        std::fill(used.begin(), used.end(), 0);
+        do {
+            used[j0] = 1;
+            int i0 = col_to_row[j0], j1 = 0;
+            double delta = INF;
+            for (int j = 1; j <= n_cols; j++) {
+                if (used[j]) continue;
+                double slack = cost[(i0 - 1) * n_cols + (j - 1)] - u[i0] - v[j];
+                if (slack < min_slack[j]) {
+                    min_slack[j] = slack;
+                    way[j] = j0;
+                }
+                if (min_slack[j] < delta) {
+                    delta = min_slack[j];
+                    j1 = j;
+                }
+            }
+            for (int j = 0; j <= n_cols; j++) {
+                if (used[j]) {
+                    u[col_to_row[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_slack[j] -= delta;
+                }
+            }
+            j0 = j1;
+        } while (col_to_row[j0] != 0);
+        //unwind the augmenting path
+        do {
+            int j1 = way[j0];
+            col_to_row[j0] = col_to_row[j1];
+            j0 = j1;
+        } while (j0 != 0);
+    }
+    row_to_col.assign(n_rows, -1);
+    for (int j = 1; j <= n_cols; j++) {
+        if (col_to_row[j] != 0) row_to_col[col_to_row[j] - 1] = j - 1;
+    }
+}
+
+//only parts of identical type are ever paired; within each type, the pairing maximizes the number of
+// precise matches, then approximate matches, then minimizes the summed pose error
+//observed_type_ids[i] and observed_poses_wrt_world[i] describe observed part i
+//if cache is given, part types whose parts have not changed since the previous call reuse that call's
+// assignment, and only the changed types are solved again
+void match_parts(const vector<int> &observed_type_ids, const vector<PlainPose> &observed_poses_wrt_world,
+        const vector<bool> &skip_observed, const vector<int> &desired_type_ids,
+        const vector<PlainPose> &desired_poses_wrt_world, const PoseToleranceProfile &tolerances,
+        vector<PartMatch> &matches, MatchScratch &scratch, StationMatchCache *cache) {
+    matches.clear();
+    //bucket candidates by part type; classification never crosses buckets
+    int n_types = 0;
+    for (int i = 0; i < (int) observed_type_ids.size(); i++) n_types = std::max(n_types, observed_type_ids[i] + 1);
+    for (int i = 0; i < (int) desired_type_ids.size(); i++) n_types = std::max(n_types, desired_type_ids[i] + 1);
+    if ((int) scratch.observed_by_type.size() < n_types) {
+        scratch.observed_by_type.resize(n_types);
+        scratch.desired_by_type.resize(n_types);
+    }
+    for (int t = 0; t < n_types; t++) {
+        scratch.observed_by_type[t].clear();
+        scratch.desired_by_type[t].clear();
+    }
+    for (int i = 0; i < (int) observed_type_ids.size(); i++) {
+        if (!skip_observed[i]) scratch.observed_by_type[observed_type_ids[i]].push_back(i);
+    }
+    for (int i = 0; i < (int) desired_type_ids.size(); i++) {
+        scratch.desired_by_type[desired_type_ids[i]].push_back(i);
+    }
+    if (cache) {
+        if ((int) cache->types.size() < n_types) cache->types.resize(n_types);
+        if ((int) cache->dirty_types.size() < n_types) cache->dirty_types.resize(n_types, 0);
+    }
+
+    vector<double> &cost = scratch.cost;
+    vector<int> &tiers = scratch.tiers, &row_to_col = scratch.row_to_col;
+    for (int type_id = 0; type_id < n_types; type_id++) {
+        const vector<int> &desired_idx = scratch.desired_by_type[type_id];
+        const vector<int> &observed_idx = scratch.observed_by_type[type_id];
+        //if none of this type in box, all are missing; if none of this type desired, all are orphans
+        if (desired_idx.empty() || observed_idx.empty()) continue;
+
+        TypeMatchCache *entry = cache ? &cache->types[type_id] : NULL;
+        if (entry && entry->generation == cache->generation - 1 && !cache->dirty_types[type_id]
+                && bucket_unchanged(*entry, observed_poses_wrt_world, observed_idx,
+                desired_poses_wrt_world, desired_idx, scratch)) {
+            //nothing of this type changed: keep the previous pairing, but re-grade it on the new poses
+            vector<int> &remapped = scratch.remapped;
+            remapped.resize(observed_idx.size());
+            for (int k = 0; k < (int) observed_idx.size(); k++) {
+                int d = entry->observed_to_desired[scratch.cached_for_current[k]];
+                remapped[k] = d;
+                if (d < 0) continue;
+                PartMatch match;
+                match.i_observed = observed_idx[k];
+                match.i_desired = desired_idx[d];
+                match.tier = match_tier(observed_poses_wrt_world[match.i_observed], desired_poses_wrt_world[match.i_desired],
+                        tolerances);
+                matches.push_back(match);
+            }
+            entry->observed_to_desired.swap(remapped);
+            store_bucket(*entry, observed_poses_wrt_world, observed_idx, desired_poses_wrt_world, desired_idx);
+            entry->generation = cache->generation;
+            continue;
+        }
+
+        //rows must be the smaller set
+        bool rows_are_observed = observed_idx.size() <= desired_idx.size();
+        const vector<int> &row_idx = rows_are_observed ? observed_idx : desired_idx;
+        const vector<int> &col_idx = rows_are_observed ? desired_idx : observed_idx;
+        int n_rows = row_idx.size();
+        int n_cols = col_idx.size();
+        cost.resize(n_rows * n_cols);
+        tiers.resize(n_rows * n_cols);
+        for (int r = 0; r < n_rows; r++) {
+            for (int c = 0; c < n_cols; c++) {
+                int i_obs = rows_are_observed ? row_idx[r] : col_idx[c];
+                int i_des = rows_are_observed ? col_idx[c] : row_idx[r];
+                const PlainPose &observed_pose = observed_poses_wrt_world[i_obs];
+                const PlainPose &desired_pose = desired_poses_wrt_world[i_des];
+                int tier = match_tier(observed_pose, desired_pose, tolerances);
+                double tier_cost = (tier == MATCH_PRECISE) ? 0.0 : ((tier == MATCH_APPROX) ? MATCH_COST_APPROX : MATCH_COST_NAME_ONLY);
+                cost[r * n_cols + c] = tier_cost + pose_error_cost(observed_pose, desired_pose);
+                tiers[r * n_cols + c] = tier;
+            }
+        }
+        solve_assignment(cost, n_rows, n_cols, row_to_col, scratch.assignment);
+        if (entry) entry->observed_to_desired.assign(observed_idx.size(), -1);
+        for (int r = 0; r < n_rows; r++) {
+            int c = row_to_col[r];
+            PartMatch match;
+            match.i_observed = rows_are_observed ? row_idx[r] : col_idx[c];
+            match.i_desired = rows_are_observed ? col_idx[c] : row_idx[r];
+            match.tier = tiers[r * n_cols + c];
+            matches.push_back(match);
+            if (entry) entry->observed_to_desired[rows_are_observed ? r : c] = rows_are_observed ? c : r;
+        }
+        if (entry) {
+            store_bucket(*entry, observed_poses_wrt_world, observed_idx, desired_poses_wrt_world, desired_idx);
+            entry->generation = cache->generation;
+        }
+    }
+    if (cache) {
+        cache->generation++;
+        std::fill(cache->dirty_types.begin(), cache->dirty_types.end(), 0);
+    }
+    //report in shipment order
+    std::sort(matches.begin(), matches.end(), part_match_by_desired_index);
+}
+
+//classification:
+int classify_parts(const vector<int> &observed_type_ids, const vector<PlainPose> &observed_poses_wrt_world,
+        const vector<int> &desired_type_ids, const vector<PlainPose> &desired_poses_wrt_world,
+        const vector<PlainPose> &faulty_poses_wrt_world, const PoseToleranceProfile &tolerances,
+        StationMatchCache *cache, ClassificationWorkspace &workspace, ClassificationResult &result) {
+    result.clear();
+    int num_parts_seen = observed_type_ids.size();
+    int num_parts_desired = desired_type_ids.size();
+
+    //don't consider the shipping box as a part:
+    vector<bool> &classified_observed_part = workspace.classified_observed_part;
+    classified_observed_part.assign(num_parts_seen, false);
+    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
+        if (observed_type_ids[ipart_seen] == SHIPPING_BOX_TYPE_ID) classified_observed_part[ipart_seen] = true;
+    }
+
+    //bad parts are orphans, wherever they are
+    int n_unmatched_faulty = 0;
+    for (int ifaulty = 0; ifaulty < (int) faulty_poses_wrt_world.size(); ifaulty++) {
+        bool found = false;
+        for (int ipart_seen = 0; (ipart_seen < num_parts_seen)&&(!found); ipart_seen++) {
+            if (classified_observed_part[ipart_seen]) continue;
+            if (pose_within_tolerance(observed_poses_wrt_world[ipart_seen], faulty_poses_wrt_world[ifaulty], tolerances.precise)) {
+                found = true;
+                classified_observed_part[ipart_seen] = true;
+                result.orphans.push_back(ipart_seen);
+                result.faulty.push_back(ipart_seen);
+            }
+        }
+        if (!found) n_unmatched_faulty++;
+    }
+
+    //pair the remaining observed parts with desired parts in one globally optimal assignment
+    vector<PartMatch> &matches = workspace.matches;
+    match_parts(observed_type_ids, observed_poses_wrt_world, classified_observed_part,
+            desired_type_ids, desired_poses_wrt_world, tolerances, matches, workspace.match_scratch, cache);
+    vector<bool> &desired_matched = workspace.desired_matched;
+    desired_matched.assign(num_parts_desired, false);
+    for (int imatch = 0; imatch < (int) matches.size(); imatch++) {
+        const PartMatch &match = matches[imatch];
+        classified_observed_part[match.i_observed] = true;
+        desired_matched[match.i_desired] = true;
+        if (match.tier == MATCH_PRECISE) {
+            result.precisely_placed.push_back(match.i_desired);
+        } else {
+            //approximate and name-only matches both need repositioning
+            result.misplaced.push_back(match.i_desired);
+            result.misplaced_observed.push_back(match.i_observed);
+        }
+    }
+
+    //any observed part left unpaired does not belong in the box: orphan
+    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
+        if (!classified_observed_part[ipart_seen]) result.orphans.push_back(ipart_seen);
+    }
+    //all unpaired desired parts are missing
+    for (int ipart = 0; ipart < num_parts_desired; ipart++) {
+        if (!desired_matched[ipart]) result.missing.push_back(ipart);
+    }
+    return n_unmatched_faulty;
+}
@@ -0,0 +1,253 @@
+//box_inspector_core.h: the box inspector's geometry and classification, free of ROS
+//everything here works on plain data (poses as seven doubles, part types as interned ints) and keeps no
+// global state: tolerances, caches and scratch space are passed in, so the core runs the same in the
+// inspector node, in tight offline loops, and in parallel worker threads (one workspace and cache each)
+//box_inspector2.cpp adapts ROS messages to these types (see box_inspector_pose_utils.cpp and
+// box_inspector_matching.cpp); the implementation is box_inspector_core.cpp, which needs only the
+// standard library
+#ifndef BOX_INSPECTOR_CORE_H
+#define BOX_INSPECTOR_CORE_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//position and orientation (unit quaternion)
+struct PlainPose {
+    double x, y, z;
+    double qx, qy, qz, qw;
+    PlainPose() : x(0.0), y(0.0), z(0.0), qx(0.0), qy(0.0), qz(0.0), qw(1.0) {}
+};
+
+struct PlainModel {
+    int type_id; //see PartTypeTable
+    PlainPose pose;
+};
+
+//part types:
+const int SHIPPING_BOX_TYPE_ID = 0; //always interned first
+const int UNKNOWN_PART_TYPE_ID = -1;
+
+//every part-type name is given a small integer id once; after that, matching, bucketing and box
+// detection compare ints instead of strings
+class PartTypeTable {
+public:
+    PartTypeTable() {
+        intern("shipping_box");
+    }
+
+    //id of type_name, adding it to the table if new
+    int intern(const std::string &type_name) {
+        std::unordered_map<std::string, int>::const_iterator it = ids_.find(type_name);
+        if (it != ids_.end()) return it->second;
+        int id = names_.size();
+        names_.push_back(type_name);
+        ids_[type_name] = id;
+        return id;
+    }
+
+    //id of type_name, or UNKNOWN_PART_TYPE_ID if it was never interned; never modifies the table
+    int find(const std::string &type_name) const {
+        std::unordered_map<std::string, int>::const_iterator it = ids_.find(type_name);
+        return (it == ids_.end()) ? UNKNOWN_PART_TYPE_ID : it->second;
+    }
+
+    const std::string &name(int id) const {
+        return names_[id];
+    }
+
+    int size() const {
+        return names_.size();
+    }
+
+private:
+    std::unordered_map<std::string, int> ids_;
+    std::vector<std::string> names_;
+};
+
+//pose tolerance checks, done directly on quaternions:
+//angle(q_A, q_B) < tol  <=>  |q_A.q_B| > cos(tol/2)|q_A||q_B|, compared in squared form to avoid sqrt/acos
+struct PoseTolerance {
+    double origin_err_tol_sq; //(m^2)
+    double cos_sq_half_orientation_tol; //negative if any orientation is acceptable
+
+    PoseTolerance(double origin_err_tol, double orientation_err_tol) {
+        set(origin_err_tol, orientation_err_tol);
+    }
+
+    void set(double origin_err_tol, double orientation_err_tol);
+};
+
+//tolerances for a precise match and for an approximate one (misplaced, but close)
+struct PoseToleranceProfile {
+    PoseTolerance precise;
+    PoseTolerance approx;
+
+    PoseToleranceProfile(double precise_origin_err_tol, double precise_orientation_err_tol,
+            double approx_origin_err_tol = 0.03, double approx_orientation_err_tol = 0.3) :
+            precise(precise_origin_err_tol, precise_orientation_err_tol),
+            approx(approx_origin_err_tol, approx_orientation_err_tol) {
+    }
+};
+
+bool pose_within_tolerance(const PlainPose &pose_A, const PlainPose &pose_B, const PoseTolerance &tolerance);
+
+//rotation angle between two unit quaternions; q and -q are the same rotation
+double quat_angle(const PlainPose &a, const PlainPose &b);
+
+//multi-frame pose fusion:
+//robust mean of several observations of one model
+PlainPose fuse_pose_samples(const std::vector<PlainPose> &samples);
+
+//fuse several frames of a static scene, newest first; frames[0] defines which models are present, and
+// fused_poses[j] gets the fused pose of its model j; each such model is associated w/ the nearest unclaimed
+// model of the same type in every other frame
+void fuse_frames(const std::vector<const std::vector<PlainModel> *> &frames, std::vector<PlainPose> &fused_poses);
+
+//batched rigid transforms:
+//structure-of-arrays pose batch; each component is contiguous, so the transform loop is branch-free
+// straight-line arithmetic that the compiler can vectorize
+struct PoseBatch {
+    std::vector<double> px, py, pz; //positions
+    std::vector<double> qx, qy, qz, qw; //orientations
+
+    int size() const {
+        return px.size();
+    }
+
+    void resize(int n) {
+        px.resize(n);
+        py.resize(n);
+        pz.resize(n);
+        qx.resize(n);
+        qy.resize(n);
+        qz.resize(n);
+        qw.resize(n);
+    }
+
+    void set(int i, const PlainPose &pose) {
+        px[i] = pose.x;
+        py[i] = pose.y;
+        pz[i] = pose.z;
+        qx[i] = pose.qx;
+        qy[i] = pose.qy;
+        qz[i] = pose.qz;
+        qw[i] = pose.qw;
+    }
+
+    void get(int i, PlainPose &pose) const {
+        pose.x = px[i];
+        pose.y = py[i];
+        pose.z = pz[i];
+        pose.qx = qx[i];
+        pose.qy = qy[i];
+        pose.qz = qz[i];
+        pose.qw = qw[i];
+    }
+};
+
+//poses_out[i] = frame_pose * poses_in_frame[i], i.e. express poses given w/rt a frame (e.g. a camera)
+// w/rt that frame's parent (e.g. world); poses_out may alias poses_in_frame
+void transform_pose_batch(const PlainPose &frame_pose, const PoseBatch &poses_in_frame, PoseBatch &poses_out);
+
+//matching observed parts to desired parts:
+enum {MATCH_PRECISE = 0, MATCH_APPROX = 1, MATCH_NAME_ONLY = 2};
+
+//one observed part paired with one desired part of the same type
+struct PartMatch {
+    int i_desired;
+    int i_observed;
+    int tier; //MATCH_PRECISE, MATCH_APPROX or MATCH_NAME_ONLY
+};
+
+//assignment of one part type, as solved at a previous inspection
+struct TypeMatchCache {
+    unsigned long generation; //inspection count at which this entry was written
+    std::vector<PlainPose> observed_poses; //world poses of this type's observed parts, bucket order
+    std::vector<PlainPose> desired_poses; //desired poses of this type, bucket order
+    std::vector<int> observed_to_desired; //bucket-local desired index for each observed part, or -1
+    TypeMatchCache() : generation(0) {}
+};
+
+//incremental matching state for one station (one box); indexed by part-type id
+struct StationMatchCache {
+    unsigned long generation; //number of inspections run with this cache
+    std::vector<TypeMatchCache> types;
+    std::vector<char> dirty_types; //types touched by a robot action since the last inspection
+    StationMatchCache() : generation(1) {}
+};
+
+//the next inspection re-matches this type even if its parts appear unchanged
+void mark_type_dirty(StationMatchCache &cache, int type_id);
+
+//forget all previous matches, e.g. when a new box arrives
+void reset_match_cache(StationMatchCache &cache);
+
+//scratch space for the Hungarian solver
+struct AssignmentScratch {
+    std::vector<double> u, v, min_slack;
+    std::vector<int> col_to_row, way;
+    std::vector<char> used;
+};
+
+//scratch space for match_parts(), reused across calls
+struct MatchScratch {
+    std::vector<std::vector<int> > observed_by_type, desired_by_type; //indexed by part-type id
+    std::vector<double> cost;
+    std::vector<int> tiers, row_to_col, cached_for_current, remapped;
+    std::vector<char> claimed;
+    AssignmentScratch assignment;
+};
+
+//Hungarian method; cost is row-major, n_rows x n_cols, n_rows <= n_cols; every row is assigned
+void solve_assignment(const std::vector<double> &cost, int n_rows, int n_cols, std::vector<int> &row_to_col,
+        AssignmentScratch &scratch);
+
+//pair observed parts with desired parts of the same type so that the total correction effort is minimal;
+// observed parts with skip_observed[i] set are never paired; with a cache, unchanged part types reuse the
+// previous call's assignment
+void match_parts(const std::vector<int> &observed_type_ids, const std::vector<PlainPose> &observed_poses_wrt_world,
+        const std::vector<bool> &skip_observed, const std::vector<int> &desired_type_ids,
+        const std::vector<PlainPose> &desired_poses_wrt_world, const PoseToleranceProfile &tolerances,
+        std::vector<PartMatch> &matches, MatchScratch &scratch, StationMatchCache *cache = NULL);
+
+//classification of a box's contents; each category is an index list into the observed parts or into the
+// desired parts that were classified against
+struct ClassificationResult {
+    std::vector<int> precisely_placed; //desired indices (part_indices_precisely_placed)
+    std::vector<int> misplaced; //desired indices (part_indices_misplaced)
+    std::vector<int> misplaced_observed; //observed index of each misplaced part, parallel to misplaced
+    std::vector<int> missing; //desired indices (part_indices_missing)
+    std::vector<int> orphans; //observed indices
+    std::vector<int> faulty; //observed indices of parts reported faulty; these are also in orphans
+
+    //empties the category lists, keeping their capacity
+    void clear() {
+        precisely_placed.clear();
+        misplaced.clear();
+        misplaced_observed.clear();
+        missing.clear();
+        orphans.clear();
+        faulty.clear();
+    }
+};
+
+//scratch space reused across classifications, so steady-state classification does not allocate
+struct ClassificationWorkspace {
+    std::vector<bool> classified_observed_part, desired_matched;
+    std::vector<PartMatch> matches;
+    MatchScratch match_scratch;
+};
+
+//classify every observed part (poses w/rt world) against the desired parts: precisely placed, misplaced,
+// missing or orphaned; observed parts of SHIPPING_BOX_TYPE_ID are ignored, and each faulty pose (as
+// reported by a quality sensor) is located among the observed parts and classified as an orphan;
+//cache, if not NULL, enables incremental re-matching (see match_parts());
+//returns the number of faulty poses that match no observed part
+int classify_parts(const std::vector<int> &observed_type_ids, const std::vector<PlainPose> &observed_poses_wrt_world,
+        const std::vector<int> &desired_type_ids, const std::vector<PlainPose> &desired_poses_wrt_world,
+        const std::vector<PlainPose> &faulty_poses_wrt_world, const PoseToleranceProfile &tolerances,
+        StationMatchCache *cache, ClassificationWorkspace &workspace, ClassificationResult &result);
+
+#endif
@@ -0,0 +1,116 @@
+//box_inspector_matching.cpp: optimal assignment of observed parts to desired parts
+// this file is included by box_inspector2.cpp
+//the assignment itself (match_parts(), in box_inspector_core.cpp) works on plain poses and type ids; this
+// file keeps the per-station state and converts the inspector's messages to and from the core's types
+
+StationMatchCache g_station_match_caches[NUM_BOX_CAMS];
+
+StationMatchCache *station_match_cache(int cam_num) {
+    if (cam_num < 1 || cam_num > NUM_BOX_CAMS) return NULL;
+    return &g_station_match_caches[cam_num - 1];
+}
+
+void note_box_action(int cam_num, const std::string &part_type) {
+    StationMatchCache *cache = station_match_cache(cam_num);
+    if (!cache) return;
+    mark_type_dirty(*cache, g_part_types.intern(part_type));
+    invalidate_box_cam_frames(*box_cam_feed(cam_num)); //frames so far show the part where it was
+    invalidate_quality_sensor_readings(cam_num); //as may readings, if the part was faulty
+}
+
+void reset_inspection_cache(int cam_num) {
+    StationMatchCache *cache = station_match_cache(cam_num);
+    if (!cache) return;
+    reset_match_cache(*cache);
+    invalidate_box_cam_frames(*box_cam_feed(cam_num)); //frames so far show the previous box, or none
+    invalidate_quality_sensor_readings(cam_num);
+}
+
+//scratch space reused across inspections at a station, so steady-state inspections do not allocate
+struct InspectionWorkspace {
+    PoseBatch pose_batch;
+    vector<geometry_msgs::Pose> observed_poses_wrt_world;
+    vector<PlainPose> observed_poses, desired_poses, faulty_poses; //the same poses, as the core takes them
+    vector<int> observed_type_ids, desired_type_ids;
+    ClassificationWorkspace classification;
+};
+
+InspectionWorkspace g_inspection_workspaces[NUM_BOX_CAMS];
+InspectionReport g_inspection_reports[NUM_BOX_CAMS];
+
+const InspectionReport *get_inspection_report(int cam_num) {
+    if (cam_num < 1 || cam_num > NUM_BOX_CAMS) return NULL;
+    return &g_inspection_reports[cam_num - 1];
+}
+
+//classify everything seen in a (filtered) box-camera image against the desired shipment:
+// precisely placed, misplaced, missing or orphaned; results go in report, replacing its previous contents
+//faulty_parts, if not NULL, are the parts reported by the quality sensor (poses w/rt world); each is located
+// in the image and classified as an orphan, all in this one pass
+//cache, if not NULL, enables incremental re-matching (see match_parts())
+void classify_box_contents(const osrf_gear::LogicalCameraImage &image,
+        const vector<osrf_gear::Model> &desired_models_wrt_world,
+        const vector<inventory_msgs::Part> *faulty_parts,
+        StationMatchCache *cache,
+        InspectionWorkspace &workspace,
+        InspectionReport &report) {
+    LATENCY_SCOPE("inspector/classify");
+    int num_parts_seen = image.models.size();
+    int num_parts_desired = desired_models_wrt_world.size();
+    intern_part_types(image.models, workspace.observed_type_ids);
+    intern_part_types(desired_models_wrt_world, workspace.desired_type_ids);
+
+    //convert every observed part to world coords once, in one batch; all steps below reuse these poses
+    vector<geometry_msgs::Pose> &observed_poses_wrt_world = workspace.observed_poses_wrt_world;
+    compute_world_poses(image, workspace.pose_batch, observed_poses_wrt_world);
+    report.observed_models.resize(num_parts_seen);
+    workspace.observed_poses.resize(num_parts_seen);
+    for (int ipart_seen = 0; ipart_seen < num_parts_seen; ipart_seen++) {
+        report.observed_models[ipart_seen].type = image.models[ipart_seen].type; //reuses string capacity
+        report.observed_models[ipart_seen].pose = observed_poses_wrt_world[ipart_seen];
+        to_plain_pose(observed_poses_wrt_world[ipart_seen], workspace.observed_poses[ipart_seen]);
+    }
+    workspace.desired_poses.resize(num_parts_desired);
+    for (int ipart = 0; ipart < num_parts_desired; ipart++) {
+        to_plain_pose(desired_models_wrt_world[ipart].pose, workspace.desired_poses[ipart]);
+    }
+    int num_faulty_parts = faulty_parts ? faulty_parts->size() : 0;
+    workspace.faulty_poses.resize(num_faulty_parts);
+    for (int ifaulty = 0; ifaulty < num_faulty_parts; ifaulty++) {
+        to_plain_pose((*faulty_parts)[ifaulty].pose.pose, workspace.faulty_poses[ifaulty]);
+    }
+
+    //bad parts become orphans, and the rest are paired in one globally optimal assignment
+    int n_unmatched_faulty = classify_parts(workspace.observed_type_ids, workspace.observed_poses,
+            workspace.desired_type_ids, workspace.desired_poses, workspace.faulty_poses, g_pose_tolerances, cache,
+            workspace.classification, report);
+    for (int i = 0; i < n_unmatched_faulty; i++) {
+        ROS_WARN("update_inspection: SOMETHING IS WRONG.  bad part reported, but does not match any parts observed by logical cam ");
+    }
+    if (!report.faulty.empty()) ROS_WARN("found %d bad parts--classified as orphaned", (int) report.faulty.size());
+    LATENCY_COUNT("inspector/faulty_parts", report.faulty.size());
+    ROS_INFO("found %d precise matches and %d misplaced parts", (int) report.precisely_placed.size(),
+            (int) report.misplaced.size());
+}
+
+//classify into station cam_num's own report (which must exist) and return it, taking bad parts from the
+// station's latest quality-sensor reading (see get_quality_sensor_reading());
+//incremental = false leaves the station's match cache alone, e.g. for one-off checks against a partial shipment
+InspectionReport &classify_station(int cam_num, const osrf_gear::LogicalCameraImage &image,
+        const vector<osrf_gear::Model> &desired_models_wrt_world, bool incremental = true) {
+    QualitySensorReadingConstPtr quality_reading;
+    if (!get_quality_sensor_reading(cam_num, g_quality_sensor_max_age, QUALITY_INSPECTION_MAX_WAIT_TIME, quality_reading)) {
+        ROS_WARN("timed  out waiting for quality inspection cam%d", cam_num);
+        quality_reading.reset();
+    }
+    InspectionReport &report = g_inspection_reports[cam_num - 1];
+    classify_box_contents(image, desired_models_wrt_world, quality_reading ? &quality_reading->faulty_parts : NULL,
+            incremental ? station_match_cache(cam_num) : NULL, g_inspection_workspaces[cam_num - 1], report);
+    return report;
+}
+
+//copy selected entries of a model list into out, reusing out's storage
+void gather_models(const vector<osrf_gear::Model> &models, const vector<int> &indices, vector<osrf_gear::Model> &out) {
+    out.resize(indices.size());
+    for (int i = 0; i < (int) indices.size(); i++) out[i] = models[indices[i]];
+}
@@ -0,0 +1,13 @@
+//box_inspector_part_types.cpp: part-type interning
+// this file is included by box_inspector2.cpp
+//every part-type name the inspector meets (in shipments or in camera frames) is given a small integer id
+// once; after that, matching, bucketing and box detection compare ints instead of strings
+//(PartTypeTable and the reserved ids are in box_inspector_core.h)
+
+//only touched from the thread that runs inspections
+PartTypeTable g_part_types;
+
+void intern_part_types(const vector<osrf_gear::Model> &models, vector<int> &type_ids) {
+    type_ids.resize(models.size());
+    for (int i = 0; i < (int) models.size(); i++) type_ids[i] = g_part_types.intern(models[i].type);
+}
@@ -0,0 +1,108 @@
+//box_inspector_pose_utils.cpp: pose math used by the box inspector
+// this file is included by box_inspector2.cpp
+//the pose math itself lives in box_inspector_core.cpp, on PlainPose; these are its ROS-side adapters
+
+void to_plain_pose(const geometry_msgs::Pose &pose, PlainPose &plain) {
+    plain.x = pose.position.x;
+    plain.y = pose.position.y;
+    plain.z = pose.position.z;
+    plain.qx = pose.orientation.x;
+    plain.qy = pose.orientation.y;
+    plain.qz = pose.orientation.z;
+    plain.qw = pose.orientation.w;
+}
+
+void from_plain_pose(const PlainPose &plain, geometry_msgs::Pose &pose) {
+    pose.position.x = plain.x;
+    pose.position.y = plain.y;
+    pose.position.z = plain.z;
+    pose.orientation.x = plain.qx;
+    pose.orientation.y = plain.qy;
+    pose.orientation.z = plain.qz;
+    pose.orientation.w = plain.qw;
+}
+
+PlainPose to_plain_pose(const geometry_msgs::Pose &pose) {
+    PlainPose plain;
+    to_plain_pose(pose, plain);
+    return plain;
+}
+
+//tolerances shared by compare_pose() (precise; hard-coded per ARIAC) and compare_pose_approx() (approx)
+PoseToleranceProfile g_pose_tolerances(ORIGIN_ERR_TOL, ORIENTATION_ERR_TOL);
+
+//optionally override the tolerances from ROS params, e.g. box_inspector/approx_origin_err_tol
+void load_pose_tolerance_profile(ros::NodeHandle &nh) {
+    double precise_origin, precise_orientation, approx_origin, approx_orientation;
+    nh.param("box_inspector/precise_origin_err_tol", precise_origin, ORIGIN_ERR_TOL);
+    nh.param("box_inspector/precise_orientation_err_tol", precise_orientation, ORIENTATION_ERR_TOL);
+    nh.param("box_inspector/approx_origin_err_tol", approx_origin, 0.03);
+    nh.param("box_inspector/approx_orientation_err_tol", approx_orientation, 0.3);
+    g_pose_tolerances.precise.set(precise_origin, precise_orientation);
+    g_pose_tolerances.approx.set(approx_origin, approx_orientation);
+}
+
+bool pose_within_tolerance(const geometry_msgs::Pose &pose_A, const geometry_msgs::Pose &pose_B,
+        const PoseTolerance &tolerance) {
+    return pose_within_tolerance(to_plain_pose(pose_A), to_plain_pose(pose_B), tolerance);
+}
+
+//fuse several frames of a static scene, newest first, into a single image w/ coords still w/rt camera;
+//the newest frame defines which models are present; each of its models is associated w/ the nearest
+// unclaimed model of the same type in every other frame, so differing model counts or orderings between
+// frames no longer cost a whole frame
+void fuse_box_cam_frames(const vector<const osrf_gear::LogicalCameraImage *> &frames,
+        osrf_gear::LogicalCameraImage &fused_image) {
+    int n_frames = frames.size();
+    vector<vector<PlainModel> > plain_frames(n_frames);
+    vector<const vector<PlainModel> *> plain_frame_ptrs(n_frames);
+    for (int i = 0; i < n_frames; i++) {
+        const vector<osrf_gear::Model> &models = frames[i]->models;
+        plain_frames[i].resize(models.size());
+        for (int k = 0; k < (int) models.size(); k++) {
+            plain_frames[i][k].type_id = g_part_types.intern(models[k].type);
+            to_plain_pose(models[k].pose, plain_frames[i][k].pose);
+        }
+        plain_frame_ptrs[i] = &plain_frames[i];
+    }
+    vector<PlainPose> fused_poses;
+    fuse_frames(plain_frame_ptrs, fused_poses);
+    fused_image = *frames[0]; //sets part names and camera pose
+    for (int j = 0; j < (int) fused_poses.size(); j++) {
+        from_plain_pose(fused_poses[j], fused_image.models[j].pose);
+    }
+}
+
+//batched rigid transforms (see PoseBatch), w/ geometry_msgs poses:
+void set_batch_pose(PoseBatch &batch, int i, const geometry_msgs::Pose &pose) {
+    batch.px[i] = pose.position.x;
+    batch.py[i] = pose.position.y;
+    batch.pz[i] = pose.position.z;
+    batch.qx[i] = pose.orientation.x;
+    batch.qy[i] = pose.orientation.y;
+    batch.qz[i] = pose.orientation.z;
+    batch.qw[i] = pose.orientation.w;
+}
+
+void get_batch_pose(const PoseBatch &batch, int i, geometry_msgs::Pose &pose) {
+    pose.position.x = batch.px[i];
+    pose.position.y = batch.py[i];
+    pose.position.z = batch.pz[i];
+    pose.orientation.x = batch.qx[i];
+    pose.orientation.y = batch.qy[i];
+    pose.orientation.z = batch.qz[i];
+    pose.orientation.w = batch.qw[i];
+}
+
+//world poses of every model in a logical-camera image, computed in one batch;
+//workspace is reused across calls to avoid reallocation; returns the single stamp for the whole batch
+ros::Time compute_world_poses(const osrf_gear::LogicalCameraImage &image, PoseBatch &workspace,
+        vector<geometry_msgs::Pose> &poses_wrt_world) {
+    int n = image.models.size();
+    workspace.resize(n);
+    for (int i = 0; i < n; i++) set_batch_pose(workspace, i, image.models[i].pose);
+    transform_pose_batch(to_plain_pose(image.pose), workspace, workspace);
+    poses_wrt_world.resize(n);
+    for (int i = 0; i < n; i++) get_batch_pose(workspace, i, poses_wrt_world[i]);
+    return ros::Time::now();
+}
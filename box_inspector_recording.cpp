@@ -0,0 +1,219 @@
+//box_inspector_recording.cpp: compact binary recording of the inspector's sensor streams
+// this file is included by box_inspector2.cpp
+//every box-camera and quality-sensor image the inspector receives can be written to a file (set the
+// param box_inspector/record_file), and read back by RecordingReader, e.g. by box_inspector_replay.cpp,
+// which feeds the frames to the same callbacks offline
+//file layout (native byte order):
+//  header:  "BXIR" (4 bytes), uint32 version
+//  records: uint8 kind, then
+//    RECORD_PART_TYPE: uint16 type id, uint16 name length, name chars  (written before a type's first use)
+//    RECORD_IMAGE:     uint8 cam_num, uint8 sensor (RECORDED_BOX_CAMERA or RECORDED_QUALITY_SENSOR),
+//                      float64 stamp (ros time of arrival, sec), float32[7] camera pose,
+//                      uint16 n_models, n_models x (uint16 type id, float32[7] pose)
+//  poses are x, y, z, qx, qy, qz, qw; float32 keeps them to well under a micron at workcell scale
+#include <stdint.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+const char RECORDING_MAGIC[4] = {'B', 'X', 'I', 'R'};
+const uint32_t RECORDING_VERSION = 1;
+const uint8_t RECORD_PART_TYPE = 1;
+const uint8_t RECORD_IMAGE = 2;
+const uint8_t RECORDED_BOX_CAMERA = 0;
+const uint8_t RECORDED_QUALITY_SENSOR = 1;
+
+void pose_to_floats(const geometry_msgs::Pose &pose, float values[7]) {
+    values[0] = pose.position.x;
+    values[1] = pose.position.y;
+    values[2] = pose.position.z;
+    values[3] = pose.orientation.x;
+    values[4] = pose.orientation.y;
+    values[5] = pose.orientation.z;
+    values[6] = pose.orientation.w;
+}
+
+void floats_to_pose(const float values[7], geometry_msgs::Pose &pose) {
+    pose.position.x = values[0];
+    pose.position.y = values[1];
+    pose.position.z = values[2];
+    pose.orientation.x = values[3];
+    pose.orientation.y = values[4];
+    pose.orientation.z = values[5];
+    pose.orientation.w = values[6];
+}
+
+//appends images to a recording; callable from any thread
+class SensorRecorder {
+public:
+    SensorRecorder() : file_(NULL), active_(false) {}
+
+    ~SensorRecorder() {
+        close();
+    }
+
+    bool open(const std::string &path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_) fclose(file_);
+        type_ids_.clear();
+        file_ = fopen(path.c_str(), "wb");
+        active_ = (file_ != NULL);
+        if (!file_) return false;
+        fwrite(RECORDING_MAGIC, 1, sizeof(RECORDING_MAGIC), file_);
+        fwrite(&RECORDING_VERSION, sizeof(RECORDING_VERSION), 1, file_);
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_) fclose(file_);
+        file_ = NULL;
+        active_ = false;
+    }
+
+    //cheap check for the callbacks, so they skip the recorder entirely when not recording
+    bool recording() const {
+        return active_.load(std::memory_order_relaxed);
+    }
+
+    void record(int cam_num, uint8_t sensor, double stamp, const osrf_gear::LogicalCameraImage &image) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!file_) return;
+        int n_models = image.models.size();
+        model_type_ids_.resize(n_models);
+        for (int i = 0; i < n_models; i++) model_type_ids_[i] = type_id(image.models[i].type);
+        uint8_t cam = cam_num;
+        uint16_t n = n_models;
+        float pose[7];
+        fwrite(&RECORD_IMAGE, 1, 1, file_);
+        fwrite(&cam, 1, 1, file_);
+        fwrite(&sensor, 1, 1, file_);
+        fwrite(&stamp, sizeof(stamp), 1, file_);
+        pose_to_floats(image.pose, pose);
+        fwrite(pose, sizeof(float), 7, file_);
+        fwrite(&n, sizeof(n), 1, file_);
+        for (int i = 0; i < n_models; i++) {
+            fwrite(&model_type_ids_[i], sizeof(uint16_t), 1, file_);
+            pose_to_floats(image.models[i].pose, pose);
+            fwrite(pose, sizeof(float), 7, file_);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    FILE *file_;
+    std::atomic<bool> active_;
+    std::map<std::string, uint16_t> type_ids_; //types already written to this file
+    vector<uint16_t> model_type_ids_;
+
+    //id of a type name in this file; writes a RECORD_PART_TYPE the first time the name is seen
+    uint16_t type_id(const std::string &type_name) {
+        std::map<std::string, uint16_t>::const_iterator it = type_ids_.find(type_name);
+        if (it != type_ids_.end()) return it->second;
+        uint16_t id = type_ids_.size();
+        uint16_t length = type_name.size();
+        type_ids_[type_name] = id;
+        fwrite(&RECORD_PART_TYPE, 1, 1, file_);
+        fwrite(&id, sizeof(id), 1, file_);
+        fwrite(&length, sizeof(length), 1, file_);
+        fwrite(type_name.data(), 1, length, file_);
+        return id;
+    }
+};
+
+SensorRecorder g_sensor_recorder;
+
+//start recording if box_inspector/record_file names a file
+void start_recording_from_params(ros::NodeHandle &nh) {
+    std::string path;
+    nh.param<std::string>("box_inspector/record_file", path, "");
+    if (path.empty()) return;
+    if (g_sensor_recorder.open(path)) {
+        ROS_INFO("recording box cameras and quality sensors to %s", path.c_str());
+    } else {
+        ROS_WARN("could not open %s for recording", path.c_str());
+    }
+}
+
+//one image read back from a recording
+struct RecordedImage {
+    int cam_num;
+    uint8_t sensor; //RECORDED_BOX_CAMERA or RECORDED_QUALITY_SENSOR
+    double stamp;
+    osrf_gear::LogicalCameraImage::Ptr image;
+};
+
+class RecordingReader {
+public:
+    RecordingReader() : file_(NULL) {}
+
+    ~RecordingReader() {
+        if (file_) fclose(file_);
+    }
+
+    bool open(const std::string &path) {
+        file_ = fopen(path.c_str(), "rb");
+        if (!file_) return false;
+        char magic[4];
+        uint32_t version;
+        if (fread(magic, 1, 4, file_) != 4 || fread(&version, sizeof(version), 1, file_) != 1
+                || memcmp(magic, RECORDING_MAGIC, 4) != 0 || version != RECORDING_VERSION) {
+            fclose(file_);
+            file_ = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    //next image in the recording; false at the end of the file (or at a truncated record)
+    bool next(RecordedImage &recorded) {
+        uint8_t kind;
+        while (file_ && fread(&kind, 1, 1, file_) == 1) {
+            if (kind == RECORD_PART_TYPE) {
+                if (!read_part_type()) return false;
+            } else if (kind == RECORD_IMAGE) {
+                return read_image(recorded);
+            } else {
+                return false; //not a record we know; can't resynchronize
+            }
+        }
+        return false;
+    }
+
+private:
+    FILE *file_;
+    vector<std::string> type_names_;
+
+    bool read_part_type() {
+        uint16_t id, length;
+        if (fread(&id, sizeof(id), 1, file_) != 1 || fread(&length, sizeof(length), 1, file_) != 1) return false;
+        std::string name(length, '\0');
+        if (length > 0 && fread(&name[0], 1, length, file_) != length) return false;
+        if (id >= type_names_.size()) type_names_.resize(id + 1);
+        type_names_[id] = name;
+        return true;
+    }
+
+    bool read_image(RecordedImage &recorded) {
+        uint8_t cam;
+        uint16_t n_models;
+        float pose[7];
+        if (fread(&cam, 1, 1, file_) != 1 || fread(&recorded.sensor, 1, 1, file_) != 1
+                || fread(&recorded.stamp, sizeof(recorded.stamp), 1, file_) != 1
+                || fread(pose, sizeof(float), 7, file_) != 7 || fread(&n_models, sizeof(n_models), 1, file_) != 1) {
+            return false;
+        }
+        recorded.cam_num = cam;
+        recorded.image.reset(new osrf_gear::LogicalCameraImage);
+        floats_to_pose(pose, recorded.image->pose);
+        recorded.image->models.resize(n_models);
+        for (int i = 0; i < n_models; i++) {
+            uint16_t id;
+            if (fread(&id, sizeof(id), 1, file_) != 1 || fread(pose, sizeof(float), 7, file_) != 7) return false;
+            if (id >= type_names_.size()) return false;
+            recorded.image->models[i].type = type_names_[id];
+            floats_to_pose(pose, recorded.image->models[i].pose);
+        }
+        return true;
+    }
+};
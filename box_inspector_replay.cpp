@@ -0,0 +1,117 @@
+//box_inspector_replay.cpp: replays a box-camera/quality-sensor recording through the inspector, offline
+//frames from a recording (see box_inspector_recording.cpp) are fed to the inspector's own callbacks, at the
+// recorded rate or faster, each with its recorded stamp; the inspector's clock is set to the stamp of the
+// frame being replayed, so every freshness check sees the same ages whatever the replay speed
+//after every box-camera frame, that station's latest frames are filtered and classified exactly as
+// update_inspection() would, and one line is printed per inspection: stream time, station, inspection
+// latency and the classification counts; the output is meant to be diffed between builds (latency aside),
+// so no Gazebo, no ROS master and no BoxInspector2 object are needed
+//the desired shipment, if given, is a text file with one part per line: type x y z qx qy qz qw (w/rt world);
+// without one, every part seen is an orphan
+//build (in a catkin workspace with the box_inspector package) as its own executable, e.g.:
+//  add_executable(box_inspector_replay src/box_inspector_replay.cpp)
+//  target_link_libraries(box_inspector_replay ${catkin_LIBRARIES})
+//run: box_inspector_replay <recording> [--speed=<factor>] [--shipment=<file>]
+//  --speed=1 (default) replays in real time, --speed=10 ten times faster, --speed=0 as fast as possible
+
+#include "box_inspector2.cpp"
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+const int REPLAY_SNAPSHOTS_PER_INSPECTION = 4; //as get_filtered_snapshots_from_box_cam()
+
+bool load_desired_shipment(const std::string &path, vector<osrf_gear::Model> &desired_models_wrt_world) {
+    std::ifstream in(path.c_str());
+    if (!in) return false;
+    osrf_gear::Model model;
+    geometry_msgs::Pose &pose = model.pose;
+    while (in >> model.type >> pose.position.x >> pose.position.y >> pose.position.z
+            >> pose.orientation.x >> pose.orientation.y >> pose.orientation.z >> pose.orientation.w) {
+        desired_models_wrt_world.push_back(model);
+    }
+    return true;
+}
+
+//filter and classify this station's most recent frames; prints one line; returns false if there was
+// nothing to inspect
+bool replay_inspection(int cam_num, double stream_time, const vector<osrf_gear::Model> &desired_models_wrt_world) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    vector<BoxCamFrameConstPtr> frames;
+    if (get_recent_box_cam_frames(*box_cam_feed(cam_num), REPLAY_SNAPSHOTS_PER_INSPECTION, BOX_CAM_MAX_FRAME_AGE, frames) == 0) {
+        return false;
+    }
+    vector<const osrf_gear::LogicalCameraImage *> images(frames.size());
+    for (int i = 0; i < (int) frames.size(); i++) images[i] = frames[i]->image.get();
+    osrf_gear::LogicalCameraImage filtered_image;
+    fuse_box_cam_frames(images, filtered_image);
+    //the latest quality-sensor reading, if fresh as the live run requires; replay never waits for another
+    QualitySensorReadingConstPtr quality_reading;
+    if (!get_quality_sensor_reading(cam_num, g_quality_sensor_max_age, 0.0, quality_reading)) quality_reading.reset();
+    InspectionReport &report = g_inspection_reports[cam_num - 1];
+    classify_box_contents(filtered_image, desired_models_wrt_world, quality_reading ? &quality_reading->faulty_parts : NULL,
+            station_match_cache(cam_num), g_inspection_workspaces[cam_num - 1], report);
+    double latency_us = 1e6 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printf("t=%.3f %s latency_us=%.1f precise=%d misplaced=%d missing=%d orphans=%d faulty=%d\n", stream_time,
+            inspection_station_config(cam_num)->name, latency_us, (int) report.precisely_placed.size(),
+            (int) report.misplaced.size(), (int) report.missing.size(), (int) report.orphans.size(),
+            (int) report.faulty.size());
+    return true;
+}
+
+int main(int argc, char** argv) {
+    std::string recording_path, shipment_path;
+    double speed = 1.0;
+    const std::string speed_flag("--speed="), shipment_flag("--shipment=");
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, speed_flag.size(), speed_flag) == 0) {
+            speed = atof(arg.substr(speed_flag.size()).c_str());
+        } else if (arg.compare(0, shipment_flag.size(), shipment_flag) == 0) {
+            shipment_path = arg.substr(shipment_flag.size());
+        } else {
+            recording_path = arg;
+        }
+    }
+    if (recording_path.empty()) {
+        fprintf(stderr, "usage: %s <recording> [--speed=<factor>] [--shipment=<file>]\n", argv[0]);
+        return 1;
+    }
+    ros::Time::init(); //ros::Time::now() without a ROS master (the inspector's clock is set per frame)
+    vector<osrf_gear::Model> desired_models_wrt_world;
+    if (!shipment_path.empty() && !load_desired_shipment(shipment_path, desired_models_wrt_world)) {
+        fprintf(stderr, "could not read shipment %s\n", shipment_path.c_str());
+        return 1;
+    }
+    RecordingReader reader;
+    if (!reader.open(recording_path)) {
+        fprintf(stderr, "%s is not a recording\n", recording_path.c_str());
+        return 1;
+    }
+
+    RecordedImage recorded;
+    double first_stamp = -1.0;
+    std::chrono::steady_clock::time_point replay_start = std::chrono::steady_clock::now();
+    int n_images = 0, n_inspections = 0;
+    while (reader.next(recorded)) {
+        if (!inspection_station_config(recorded.cam_num)) continue;
+        if (first_stamp < 0.0) first_stamp = recorded.stamp;
+        double stream_time = recorded.stamp - first_stamp;
+        if (speed > 0.0) {
+            std::this_thread::sleep_until(replay_start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(stream_time / speed)));
+        }
+        n_images++;
+        set_inspector_clock(recorded.stamp);
+        if (recorded.sensor == RECORDED_QUALITY_SENSOR) {
+            receive_quality_sensor_image(recorded.cam_num, recorded.stamp, recorded.image);
+        } else {
+            receive_box_camera_image(recorded.cam_num, recorded.stamp, recorded.image);
+            if (replay_inspection(recorded.cam_num, stream_time, desired_models_wrt_world)) n_inspections++;
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - replay_start).count();
+    printf("replayed %d images, %d inspections in %.3f sec\n", n_images, n_inspections, elapsed);
+    printf("%s", latency_stats().summary().c_str());
+    return 0;
+}
@@ -0,0 +1,124 @@
+//box_inspector_snapshots.cpp: event-driven delivery of box-camera frames
+// this file is included by box_inspector2.cpp
+//box-camera subscriptions are serviced by a dedicated callback queue and spinner thread, so a caller
+// waiting for a new frame is woken the moment the frame arrives, instead of polling spinOnce()/sleep()
+//every frame is kept in a small per-camera ring buffer, so a filtered snapshot can usually be built
+// from frames that have already arrived, without waiting at all
+//frame ages are measured on the inspector's clock (inspector_now()): ros time when live, the recording's own
+// stamps when replayed, so a replay judges freshness exactly as the live run did, at any replay speed
+#include <ros/callback_queue.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+const int NUM_BOX_CAMS = 2;
+const int BOX_CAM_RING_SIZE = 8; //most recent frames retained per camera
+const double BOX_CAM_MAX_FRAME_AGE = 0.5; //(sec) older frames are not used for filtered snapshots
+
+struct BoxCamFrame {
+    osrf_gear::LogicalCameraImage::ConstPtr image;
+    double stamp; //inspector-clock time of arrival, in sec
+    unsigned long seq; //position in the camera's frame sequence
+};
+typedef boost::shared_ptr<const BoxCamFrame> BoxCamFrameConstPtr;
+
+//single producer (the box-cam spinner thread), any number of readers;
+// slots are published with atomic shared_ptr stores, so readers never block the callback
+struct BoxCamFeed {
+    BoxCamFrameConstPtr ring[BOX_CAM_RING_SIZE];
+    std::atomic<unsigned long> frame_count; //incremented for every frame received
+    std::atomic<unsigned long> first_valid_seq; //earlier frames predate the latest robot action in the box
+    //used only to wake callers blocked waiting for the next frame
+    std::mutex mutex;
+    std::condition_variable frame_arrived;
+    BoxCamFeed() : frame_count(0), first_valid_seq(0) {}
+};
+
+BoxCamFeed g_box_cam_feeds[NUM_BOX_CAMS];
+ros::CallbackQueue g_box_cam_queue;
+ros::AsyncSpinner *g_box_cam_spinner = NULL;
+
+//returns NULL if cam_num is not recognized
+BoxCamFeed *box_cam_feed(int cam_num) {
+    if (cam_num < 1 || cam_num > NUM_BOX_CAMS) return NULL;
+    return &g_box_cam_feeds[cam_num - 1];
+}
+
+std::atomic<bool> g_inspector_clock_set(false);
+std::atomic<double> g_inspector_clock(0.0);
+
+//the time (sec) against which frame and reading ages are measured: ros time, unless set_inspector_clock()
+// has been called
+double inspector_now() {
+    if (g_inspector_clock_set.load(std::memory_order_acquire)) return g_inspector_clock.load(std::memory_order_acquire);
+    return ros::Time::now().toSec();
+}
+
+//drive the inspector's clock explicitly from now on, e.g. with the stamps of a recording being replayed
+void set_inspector_clock(double now) {
+    g_inspector_clock.store(now, std::memory_order_release);
+    g_inspector_clock_set.store(true, std::memory_order_release);
+}
+
+//start servicing box-camera callbacks in the background; subscriptions must be made through
+// a node handle whose callback queue is g_box_cam_queue
+void start_box_cam_spinner() {
+    if (g_box_cam_spinner) return;
+    g_box_cam_spinner = new ros::AsyncSpinner(1, &g_box_cam_queue);
+    g_box_cam_spinner->start();
+}
+
+//called from the camera callbacks (spinner thread) with the frame's arrival time (inspector clock);
+// stores the frame and wakes any waiting caller
+void post_box_cam_frame(BoxCamFeed &feed, double stamp, const osrf_gear::LogicalCameraImage::ConstPtr &image_msg) {
+    boost::shared_ptr<BoxCamFrame> frame(new BoxCamFrame);
+    frame->image = image_msg;
+    frame->stamp = stamp;
+    frame->seq = feed.frame_count.load(std::memory_order_relaxed);
+    boost::atomic_store(&feed.ring[frame->seq % BOX_CAM_RING_SIZE], BoxCamFrameConstPtr(frame));
+    feed.frame_count.store(frame->seq + 1, std::memory_order_release);
+    {
+        //empty critical section orders the update w/rt a waiter that is about to sleep
+        std::lock_guard<std::mutex> lock(feed.mutex);
+    }
+    feed.frame_arrived.notify_all();
+}
+
+//the box contents just changed (robot action, new box): frames received so far show the old contents, and
+// must not be fused with new ones; the fence is a frame count rather than a time, so it does not depend on
+// how arrival times are stamped
+void invalidate_box_cam_frames(BoxCamFeed &feed) {
+    feed.first_valid_seq.store(feed.frame_count.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+//copy up to n_frames of the most recent frames, newest first, skipping frames older than max_age and
+// frames received before the latest invalidate_box_cam_frames();
+//returns the number of frames copied
+int get_recent_box_cam_frames(BoxCamFeed &feed, int n_frames, double max_age,
+        vector<BoxCamFrameConstPtr> &frames) {
+    frames.clear();
+    unsigned long frame_count = feed.frame_count.load(std::memory_order_acquire);
+    unsigned long first_valid_seq = feed.first_valid_seq.load(std::memory_order_acquire);
+    double oldest_stamp = inspector_now() - max_age;
+    if (n_frames > BOX_CAM_RING_SIZE) n_frames = BOX_CAM_RING_SIZE;
+    for (unsigned long seq = frame_count; seq > first_valid_seq && (int) frames.size() < n_frames; seq--) {
+        BoxCamFrameConstPtr frame = boost::atomic_load(&feed.ring[(seq - 1) % BOX_CAM_RING_SIZE]);
+        //stop at a slot already overwritten by a newer frame, or at the first stale frame
+        if (!frame || frame->seq != seq - 1 || frame->stamp < oldest_stamp) break;
+        frames.push_back(frame);
+    }
+    return frames.size();
+}
+
+//block until a frame newer than the time of this call arrives, or until timeout (seconds)
+bool wait_for_box_cam_frame(BoxCamFeed &feed, double timeout, BoxCamFrameConstPtr &frame) {
+    std::unique_lock<std::mutex> lock(feed.mutex);
+    unsigned long frame_count_at_call = feed.frame_count.load(std::memory_order_acquire);
+    bool got_frame = feed.frame_arrived.wait_for(lock, std::chrono::duration<double>(timeout),
+            [&feed, frame_count_at_call]() { return feed.frame_count.load(std::memory_order_acquire) != frame_count_at_call; });
+    if (!got_frame) return false;
+    unsigned long seq = feed.frame_count.load(std::memory_order_acquire) - 1;
+    frame = boost::atomic_load(&feed.ring[seq % BOX_CAM_RING_SIZE]);
+    return true;
+}
@@ -0,0 +1,223 @@
+//box_inspector_stations.cpp: the table of inspection stations, and per-station sensor state
+// this file is included by box_inspector2.cpp
+//everything that differs between stations is in INSPECTION_STATIONS; the inspector loops over this
+// table instead of keeping a copy of each code path per station, so a station is added by adding a row
+// (and raising NUM_BOX_CAMS)
+//quality sensors are tracked continuously: their callbacks run on the box-cam spinner thread and publish
+// every reading (all faulty parts seen, w/rt world, with arrival time), so a caller uses the latest
+// reading at once if it is fresh enough, and waits only when it is not
+
+const InspectionStationConfig INSPECTION_STATIONS[NUM_BOX_CAMS] = {
+    //name, cam, box camera topic, quality sensor topic, location code, nominal box position
+    {"Q1", CAM1, "/ariac/box_camera_1", "/ariac/quality_control_sensor_1", inventory_msgs::Part::QUALITY_SENSOR_1, 0.55, 0.61, 0.588},
+    {"Q2", CAM2, "/ariac/box_camera_2", "/ariac/quality_control_sensor_2", inventory_msgs::Part::QUALITY_SENSOR_2, 0.55, 0.266, 0.588}
+};
+
+const double QUALITY_SENSOR_MAX_AGE = 0.5; //(sec) default freshness bound for quality-sensor readings
+double g_quality_sensor_max_age = QUALITY_SENSOR_MAX_AGE;
+
+//one quality-sensor reading
+struct QualitySensorReading {
+    double stamp; //inspector-clock time of arrival, in sec (see inspector_now())
+    unsigned long seq; //position in the sensor's reading sequence
+    vector<inventory_msgs::Part> faulty_parts; //every faulty part seen, w/rt world
+};
+typedef boost::shared_ptr<const QualitySensorReading> QualitySensorReadingConstPtr;
+
+//single producer (the sensor callback), any number of readers; same scheme as BoxCamFeed
+struct QualitySensorTrack {
+    QualitySensorReadingConstPtr latest; //accessed with atomic_load/atomic_store only
+    std::atomic<unsigned long> reading_count;
+    std::atomic<unsigned long> first_valid_seq; //earlier readings predate the latest robot action in the box
+    std::mutex mutex; //used only to wake callers waiting for the next reading
+    std::condition_variable reading_arrived;
+    //callback-thread scratch space
+    PoseBatch pose_workspace;
+    vector<geometry_msgs::Pose> poses_wrt_world;
+    QualitySensorTrack() : reading_count(0), first_valid_seq(0) {}
+};
+
+struct InspectionStationState {
+    ros::Subscriber box_camera_subscriber;
+    ros::Subscriber quality_sensor_subscriber;
+    QualitySensorTrack quality_sensor;
+};
+
+InspectionStationState g_inspection_station_states[NUM_BOX_CAMS];
+
+int num_inspection_stations() {
+    return NUM_BOX_CAMS;
+}
+
+const InspectionStationConfig *inspection_station_config(int cam_num) {
+    if (cam_num < 1 || cam_num > NUM_BOX_CAMS) return NULL;
+    return &INSPECTION_STATIONS[cam_num - 1];
+}
+
+//NULL if cam_num is not recognized
+InspectionStationState *inspection_station_state(int cam_num) {
+    if (cam_num < 1 || cam_num > NUM_BOX_CAMS) return NULL;
+    return &g_inspection_station_states[cam_num - 1];
+}
+
+geometry_msgs::PoseStamped nominal_box_pose(const InspectionStationConfig &station) {
+    geometry_msgs::PoseStamped box_pose;
+    box_pose.header.frame_id = "world";
+    box_pose.pose.position.x = station.nom_box_x;
+    box_pose.pose.position.y = station.nom_box_y;
+    box_pose.pose.position.z = station.nom_box_z;
+    box_pose.pose.orientation.x = 0.0;
+    box_pose.pose.orientation.y = 0.0;
+    box_pose.pose.orientation.z = 0.0;
+    box_pose.pose.orientation.w = 1.0;
+    return box_pose;
+}
+
+//a box-camera image that arrived at stamp (inspector clock): live, from the callback below; replayed, with
+// its recorded stamp
+void receive_box_camera_image(int cam_num, double stamp, const osrf_gear::LogicalCameraImage::ConstPtr &image_msg) {
+    if (g_sensor_recorder.recording()) {
+        g_sensor_recorder.record(cam_num, RECORDED_BOX_CAMERA, stamp, *image_msg);
+    }
+    post_box_cam_frame(*box_cam_feed(cam_num), stamp, image_msg);
+}
+
+void box_camera_callback_for(int cam_num, const osrf_gear::LogicalCameraImage::ConstPtr &image_msg) {
+    receive_box_camera_image(cam_num, inspector_now(), image_msg);
+}
+
+//as receive_box_camera_image(), for a quality-sensor image; runs on the box-cam spinner thread when live
+void receive_quality_sensor_image(int cam_num, double stamp, const osrf_gear::LogicalCameraImage::ConstPtr &image_msg) {
+    if (g_sensor_recorder.recording()) {
+        g_sensor_recorder.record(cam_num, RECORDED_QUALITY_SENSOR, stamp, *image_msg);
+    }
+    QualitySensorTrack &sensor = g_inspection_station_states[cam_num - 1].quality_sensor;
+    boost::shared_ptr<QualitySensorReading> reading(new QualitySensorReading);
+    compute_world_poses(*image_msg, sensor.pose_workspace, sensor.poses_wrt_world);
+    reading->stamp = stamp;
+    reading->seq = sensor.reading_count.load(std::memory_order_relaxed);
+    int n_faulty = image_msg->models.size();
+    reading->faulty_parts.resize(n_faulty);
+    for (int i = 0; i < n_faulty; i++) {
+        inventory_msgs::Part &part = reading->faulty_parts[i];
+        part.name = image_msg->models[i].type;
+        part.pose.header.frame_id = "world";
+        part.pose.pose = sensor.poses_wrt_world[i];
+        part.location = INSPECTION_STATIONS[cam_num - 1].location_code;
+    }
+    boost::atomic_store(&sensor.latest, QualitySensorReadingConstPtr(reading));
+    sensor.reading_count.store(reading->seq + 1, std::memory_order_release);
+    {
+        //empty critical section orders the update w/rt a waiter that is about to sleep
+        std::lock_guard<std::mutex> lock(sensor.mutex);
+    }
+    sensor.reading_arrived.notify_all();
+}
+
+void quality_sensor_callback_for(int cam_num, const osrf_gear::LogicalCameraImage::ConstPtr &image_msg) {
+    receive_quality_sensor_image(cam_num, inspector_now(), image_msg);
+}
+
+//the box contents just changed: readings so far may report a bad part the robot has just removed, or miss
+// one it has just placed; like invalidate_box_cam_frames(), the fence is a reading count
+void invalidate_quality_sensor_readings(int cam_num) {
+    InspectionStationState *station = inspection_station_state(cam_num);
+    if (!station) return;
+    QualitySensorTrack &sensor = station->quality_sensor;
+    sensor.first_valid_seq.store(sensor.reading_count.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+//the latest reading of this station's quality sensor, if it is no older than max_age and arrived after the
+// latest invalidate_quality_sensor_readings(); otherwise waits up to timeout (sec) for the next such reading;
+// returns false on timeout or if cam_num is not recognized
+bool get_quality_sensor_reading(int cam_num, double max_age, double timeout, QualitySensorReadingConstPtr &reading) {
+    InspectionStationState *station = inspection_station_state(cam_num);
+    if (!station) return false;
+    QualitySensorTrack &sensor = station->quality_sensor;
+    unsigned long first_valid_seq = sensor.first_valid_seq.load(std::memory_order_acquire);
+    reading = boost::atomic_load(&sensor.latest);
+    if (reading && reading->seq >= first_valid_seq && inspector_now() - reading->stamp <= max_age) {
+        LATENCY_COUNT("inspector/quality_sensor_fresh", 1);
+        return true;
+    }
+    LATENCY_SCOPE("inspector/quality_sensor_wait");
+    std::unique_lock<std::mutex> lock(sensor.mutex);
+    unsigned long reading_count_at_call = std::max(reading ? reading->seq + 1 : 0, first_valid_seq);
+    bool got_reading = sensor.reading_arrived.wait_for(lock, std::chrono::duration<double>(timeout),
+            [&sensor, reading_count_at_call]() { return sensor.reading_count.load(std::memory_order_acquire) > reading_count_at_call; });
+    if (!got_reading) {
+        LATENCY_COUNT("inspector/quality_sensor_timeouts", 1);
+        return false;
+    }
+    reading = boost::atomic_load(&sensor.latest);
+    return true;
+}
+
+bool get_faulty_parts(int cam_num, vector<inventory_msgs::Part> &faulty_parts) {
+    QualitySensorReadingConstPtr reading;
+    if (!get_quality_sensor_reading(cam_num, g_quality_sensor_max_age, QUALITY_INSPECTION_MAX_WAIT_TIME, reading)) return false;
+    faulty_parts = reading->faulty_parts;
+    return true;
+}
+
+//readiness: a sensor is ready once it has delivered its first message; nothing waits for this at
+// construction, so the node starts at once and each sensor warms up in the background
+bool box_camera_ready(int cam_num) {
+    BoxCamFeed *feed = box_cam_feed(cam_num);
+    return feed && feed->frame_count.load(std::memory_order_acquire) > 0;
+}
+
+bool quality_sensor_ready(int cam_num) {
+    InspectionStationState *station = inspection_station_state(cam_num);
+    return station && station->quality_sensor.reading_count.load(std::memory_order_acquire) > 0;
+}
+
+bool inspection_station_ready(int cam_num) {
+    return box_camera_ready(cam_num) && quality_sensor_ready(cam_num);
+}
+
+//block until message_count is nonzero or until deadline
+bool wait_for_first_message(std::mutex &mutex, std::condition_variable &message_arrived,
+        const std::atomic<unsigned long> &message_count, std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return message_arrived.wait_until(lock, deadline,
+            [&message_count]() { return message_count.load(std::memory_order_acquire) > 0; });
+}
+
+bool wait_for_inspection_stations(double timeout) {
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeout));
+    bool all_ready = true;
+    for (int i = 0; i < NUM_BOX_CAMS; i++) {
+        const InspectionStationConfig &station = INSPECTION_STATIONS[i];
+        BoxCamFeed &feed = g_box_cam_feeds[i];
+        QualitySensorTrack &sensor = g_inspection_station_states[i].quality_sensor;
+        //once the deadline has passed, the remaining sensors are only checked, not waited for
+        if (!wait_for_first_message(feed.mutex, feed.frame_arrived, feed.frame_count, deadline)) {
+            ROS_WARN("no message yet from %s", station.box_camera_topic);
+            all_ready = false;
+        }
+        if (!wait_for_first_message(sensor.mutex, sensor.reading_arrived, sensor.reading_count, deadline)) {
+            ROS_WARN("no message yet from %s", station.quality_sensor_topic);
+            all_ready = false;
+        }
+    }
+    return all_ready;
+}
+
+void load_quality_sensor_params(ros::NodeHandle &nh) {
+    nh.param("box_inspector/quality_sensor_max_age", g_quality_sensor_max_age, QUALITY_SENSOR_MAX_AGE);
+}
+
+//subscribe to every station's box camera and quality sensor, through box_cam_nh, whose queue is
+// g_box_cam_queue
+void subscribe_inspection_stations(ros::NodeHandle &box_cam_nh) {
+    for (int i = 0; i < NUM_BOX_CAMS; i++) {
+        const InspectionStationConfig &station = INSPECTION_STATIONS[i];
+        InspectionStationState &state = g_inspection_station_states[i];
+        state.box_camera_subscriber = box_cam_nh.subscribe<osrf_gear::LogicalCameraImage>(station.box_camera_topic, 1,
+                boost::bind(&box_camera_callback_for, station.cam_num, _1));
+        state.quality_sensor_subscriber = box_cam_nh.subscribe<osrf_gear::LogicalCameraImage>(station.quality_sensor_topic, 1,
+                boost::bind(&quality_sensor_callback_for, station.cam_num, _1));
+    }
+}
@@ -0,0 +1,69 @@
+//box_inspector_templates.cpp: shipment templates
+// this file is included by box_inspector2.cpp
+//a shipment's desired parts, w/rt its box, do not change from one box (or station) to the next; each
+// shipment is converted once, by compute_shipment_poses_wrt_world() against the identity box pose, into a
+// template of interned type ids and box-relative poses; desired poses w/rt world for a box in any pose are
+// then one batched rigid transform of the template (transform_pose_batch())
+
+struct ShipmentTemplate {
+    std::string shipment_type;
+    vector<osrf_gear::Product> products; //as received; a re-sent shipment under the same name is re-converted
+    vector<int> type_ids;
+    PoseBatch poses_wrt_box;
+};
+
+//only touched from the thread that runs inspections; an entry per shipment seen, so a linear search is fine
+vector<ShipmentTemplate> g_shipment_templates;
+PoseBatch g_template_workspace;
+
+bool same_products(const vector<osrf_gear::Product> &a, const vector<osrf_gear::Product> &b) {
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < (int) a.size(); i++) {
+        const geometry_msgs::Pose &pose_a = a[i].pose;
+        const geometry_msgs::Pose &pose_b = b[i].pose;
+        if (a[i].type != b[i].type
+                || pose_a.position.x != pose_b.position.x || pose_a.position.y != pose_b.position.y
+                || pose_a.position.z != pose_b.position.z
+                || pose_a.orientation.x != pose_b.orientation.x || pose_a.orientation.y != pose_b.orientation.y
+                || pose_a.orientation.z != pose_b.orientation.z || pose_a.orientation.w != pose_b.orientation.w) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const ShipmentTemplate &shipment_template(BoxInspector2 &inspector, const osrf_gear::Shipment &shipment) {
+    ShipmentTemplate *found = NULL;
+    for (int i = 0; i < (int) g_shipment_templates.size() && !found; i++) {
+        if (g_shipment_templates[i].shipment_type == shipment.shipment_type) found = &g_shipment_templates[i];
+    }
+    if (found && same_products(found->products, shipment.products)) return *found;
+    if (!found) {
+        g_shipment_templates.push_back(ShipmentTemplate());
+        found = &g_shipment_templates.back();
+    }
+    found->shipment_type = shipment.shipment_type;
+    found->products = shipment.products;
+    //the identity box pose makes "world" the box frame
+    geometry_msgs::PoseStamped box_frame;
+    box_frame.header.frame_id = "world";
+    box_frame.pose.orientation.w = 1.0;
+    vector<osrf_gear::Model> models_wrt_box;
+    inspector.compute_shipment_poses_wrt_world(shipment, box_frame, models_wrt_box);
+    intern_part_types(models_wrt_box, found->type_ids);
+    found->poses_wrt_box.resize(models_wrt_box.size());
+    for (int i = 0; i < (int) models_wrt_box.size(); i++) set_batch_pose(found->poses_wrt_box, i, models_wrt_box[i].pose);
+    return *found;
+}
+
+void compute_shipment_poses_from_template(BoxInspector2 &inspector, const osrf_gear::Shipment &shipment,
+        const geometry_msgs::PoseStamped &box_pose_wrt_world, vector<osrf_gear::Model> &desired_models_wrt_world) {
+    const ShipmentTemplate &shipment_tmpl = shipment_template(inspector, shipment);
+    transform_pose_batch(to_plain_pose(box_pose_wrt_world.pose), shipment_tmpl.poses_wrt_box, g_template_workspace);
+    int n = shipment_tmpl.type_ids.size();
+    desired_models_wrt_world.resize(n);
+    for (int i = 0; i < n; i++) {
+        desired_models_wrt_world[i].type = g_part_types.name(shipment_tmpl.type_ids[i]);
+        get_batch_pose(g_template_workspace, i, desired_models_wrt_world[i].pose);
+    }
+}
@@ -0,0 +1,193 @@
+//latency_stats.h: per-stage latency histograms and event counters, shared by the box inspector and the
+// box unloader, so one process-wide collector sees both
+//a stage or counter is registered by name once (LATENCY_SCOPE() and LATENCY_COUNT() keep the id in a
+// function-local static); after that, recording takes no lock: a sample is a few relaxed atomic adds into
+// log-spaced buckets, 4 per power of two, so reported percentiles are within ~20% of the true value
+//summary() may be called from any thread at any time, e.g. by a periodic dump (see unload_box_latency.cpp)
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+const int LATENCY_SUB_BUCKETS = 4; //buckets per power of two; must stay 4 (see latency_bucket())
+const int LATENCY_NUM_BUCKETS = 252; //covers every uint64 nanosecond count
+const int MAX_LATENCY_STAGES = 64;
+const int MAX_LATENCY_COUNTERS = 64;
+
+//bucket of a duration: exact below 4 ns, then 4 buckets per octave
+inline int latency_bucket(uint64_t ns) {
+    if (ns < LATENCY_SUB_BUCKETS) return ns;
+    int octave = 63 - __builtin_clzll(ns); //>= 2
+    int sub = (ns >> (octave - 2)) & 3;
+    return (octave - 1) * LATENCY_SUB_BUCKETS + sub;
+}
+
+//largest duration that falls in bucket
+inline uint64_t latency_bucket_upper_ns(int bucket) {
+    if (bucket < LATENCY_SUB_BUCKETS) return bucket;
+    int octave = bucket / LATENCY_SUB_BUCKETS + 1;
+    uint64_t lower = (uint64_t) (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << (octave - 2);
+    return lower + ((uint64_t) 1 << (octave - 2)) - 1;
+}
+
+struct LatencyHistogram {
+    std::atomic<uint64_t> total_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> buckets[LATENCY_NUM_BUCKETS];
+
+    LatencyHistogram() : total_ns(0), max_ns(0) {
+        for (int i = 0; i < LATENCY_NUM_BUCKETS; i++) buckets[i].store(0, std::memory_order_relaxed);
+    }
+
+    void record(uint64_t ns) {
+        buckets[latency_bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+        total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max_so_far = max_ns.load(std::memory_order_relaxed);
+        while (ns > max_so_far && !max_ns.compare_exchange_weak(max_so_far, ns, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+class LatencyStats {
+public:
+    LatencyStats() : n_stages_(0), n_counters_(0) {
+        for (int i = 0; i < MAX_LATENCY_COUNTERS; i++) counters_[i].store(0, std::memory_order_relaxed);
+    }
+
+    //id of a timing stage, registering it if new; -1 once MAX_LATENCY_STAGES are registered
+    int stage(const std::string &name) {
+        return register_name(name, stage_names_, n_stages_, MAX_LATENCY_STAGES);
+    }
+
+    //id of an event counter, registering it if new; -1 once MAX_LATENCY_COUNTERS are registered
+    int counter(const std::string &name) {
+        return register_name(name, counter_names_, n_counters_, MAX_LATENCY_COUNTERS);
+    }
+
+    void record(int stage_id, uint64_t ns) {
+        if (stage_id >= 0) stages_[stage_id].record(ns);
+    }
+
+    //for durations measured elsewhere, e.g. w/ ros::Time
+    void record_seconds(int stage_id, double seconds) {
+        record(stage_id, seconds > 0.0 ? (uint64_t) (seconds * 1e9) : 0);
+    }
+
+    void increment(int counter_id, uint64_t n = 1) {
+        if (counter_id >= 0) counters_[counter_id].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    //one line per stage: name, count, p50, p99, max and mean (ms); then one line per counter: name, count;
+    // samples recorded concurrently may or may not be included
+    std::string summary() const {
+        std::string text;
+        char line[160];
+        int n_stages = n_stages_.load(std::memory_order_acquire);
+        for (int i = 0; i < n_stages; i++) {
+            const LatencyHistogram &histogram = stages_[i];
+            uint64_t counts[LATENCY_NUM_BUCKETS];
+            uint64_t n_samples = 0;
+            for (int b = 0; b < LATENCY_NUM_BUCKETS; b++) {
+                counts[b] = histogram.buckets[b].load(std::memory_order_relaxed);
+                n_samples += counts[b];
+            }
+            if (n_samples == 0) continue;
+            uint64_t max_ns = histogram.max_ns.load(std::memory_order_relaxed);
+            snprintf(line, sizeof(line), "%-36s n=%-8llu p50=%.3fms p99=%.3fms max=%.3fms mean=%.3fms\n",
+                    stage_names_[i].c_str(), (unsigned long long) n_samples,
+                    1e-6 * std::min(percentile_ns(counts, n_samples, 0.50), max_ns),
+                    1e-6 * std::min(percentile_ns(counts, n_samples, 0.99), max_ns), 1e-6 * max_ns,
+                    1e-6 * histogram.total_ns.load(std::memory_order_relaxed) / n_samples);
+            text += line;
+        }
+        int n_counters = n_counters_.load(std::memory_order_acquire);
+        for (int i = 0; i < n_counters; i++) {
+            snprintf(line, sizeof(line), "%-36s n=%llu\n", counter_names_[i].c_str(),
+                    (unsigned long long) counters_[i].load(std::memory_order_relaxed));
+            text += line;
+        }
+        return text;
+    }
+
+private:
+    std::mutex registration_mutex_; //taken only to register a new name
+    std::string stage_names_[MAX_LATENCY_STAGES];
+    std::string counter_names_[MAX_LATENCY_COUNTERS];
+    std::atomic<int> n_stages_, n_counters_; //names below these counts are published and never change
+    LatencyHistogram stages_[MAX_LATENCY_STAGES];
+    std::atomic<uint64_t> counters_[MAX_LATENCY_COUNTERS];
+
+    int register_name(const std::string &name, std::string *names, std::atomic<int> &n_names, int max_names) {
+        std::lock_guard<std::mutex> lock(registration_mutex_);
+        int n = n_names.load(std::memory_order_relaxed);
+        for (int i = 0; i < n; i++) {
+            if (names[i] == name) return i;
+        }
+        if (n == max_names) return -1;
+        names[n] = name;
+        n_names.store(n + 1, std::memory_order_release);
+        return n;
+    }
+
+    //upper bound of the bucket holding the sample of rank fraction*n_samples
+    static uint64_t percentile_ns(const uint64_t *counts, uint64_t n_samples, double fraction) {
+        uint64_t rank = (uint64_t) (fraction * (n_samples - 1)) + 1;
+        uint64_t cumulative = 0;
+        for (int b = 0; b < LATENCY_NUM_BUCKETS; b++) {
+            cumulative += counts[b];
+            if (cumulative >= rank) return latency_bucket_upper_ns(b);
+        }
+        return latency_bucket_upper_ns(LATENCY_NUM_BUCKETS - 1);
+    }
+};
+
+//the process-wide collector
+inline LatencyStats &latency_stats() {
+    static LatencyStats stats;
+    return stats;
+}
+
+//records the time from construction to destruction under one stage
+class ScopedLatencyTimer {
+public:
+    explicit ScopedLatencyTimer(int stage_id) : stage_id_(stage_id), start_(std::chrono::steady_clock::now()) {}
+
+    ~ScopedLatencyTimer() {
+        latency_stats().record(stage_id_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start_).count());
+    }
+
+private:
+    int stage_id_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+#define LATENCY_CONCAT_(a, b) a##b
+#define LATENCY_CONCAT(a, b) LATENCY_CONCAT_(a, b)
+
+//time the rest of the enclosing block as stage name (a string literal)
+#define LATENCY_SCOPE(name) \
+    static const int LATENCY_CONCAT(latency_stage_, __LINE__) = latency_stats().stage(name); \
+    ScopedLatencyTimer LATENCY_CONCAT(latency_timer_, __LINE__)(LATENCY_CONCAT(latency_stage_, __LINE__))
+
+//add n to counter name (a string literal)
+#define LATENCY_COUNT(name, n) \
+    do { \
+        static const int latency_counter_id = latency_stats().counter(name); \
+        latency_stats().increment(latency_counter_id, n); \
+    } while (0)
+
+//record an externally measured duration (seconds) under stage name (a string literal)
+#define LATENCY_RECORD_SECONDS(name, seconds) \
+    do { \
+        static const int latency_stage_id = latency_stats().stage(name); \
+        latency_stats().record_seconds(latency_stage_id, seconds); \
+    } while (0)
+
+#endif
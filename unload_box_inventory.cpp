@@ -0,0 +1,88 @@
+//unload_box_inventory.cpp: cached bin inventory for fetching missing parts
+// this file is included by unload_box_v4.cpp
+//a bin-camera scan (BinInventory::update()) is slow; rather than scanning before every pick, the cache
+// indexes the latest inventory snapshot by part type: a list of the available parts of each type; a pick
+// takes its part off the list at once (optimistically, before any scan confirms it is gone), so the next
+// part of the same type comes straight from the list, and marks the snapshot stale
+//the pipeline rescans while the robot would otherwise be idle (refresh_if_stale()); find_part() scans only
+// if there is no snapshot yet, or if a type's list has run out since the last scan
+//no scan runs in the background: BinInventory::update() spins the global callback queue, so a scan on
+// another thread would run the order, conveyor and robot callbacks concurrently with the pipeline
+
+#include <map>
+
+const double PICKED_PART_MATCH_DISTANCE = 0.01; //(m) a part this close to a picked part is that part
+
+//used from the main thread only
+class BinInventoryCache {
+public:
+    BinInventoryCache(BinInventory *bin_inventory) : bin_inventory_(bin_inventory), have_snapshot_(false),
+            stale_(false) {}
+
+    //find an available part of this type in the bins; scans the bins only if there is no snapshot yet, or if
+    // every part of this type in the latest snapshot has been picked since
+    bool find_part(const std::string &part_type, inventory_msgs::Part &part) {
+        if (!have_snapshot_) scan();
+        vector<inventory_msgs::Part> *available = &available_[part_type];
+        if (available->empty()) {
+            if (!stale_) return false; //none of this type in the bins
+            scan(); //a part thought picked may still be there
+            available = &available_[part_type];
+            if (available->empty()) return false;
+        }
+        part = available->back();
+        return true;
+    }
+
+    //the robot has just picked (or tried to pick) this part from a bin: take it off its type's list; the
+    // snapshot is stale until the next scan; never waits for a scan
+    void note_picked(const inventory_msgs::Part &part) {
+        vector<inventory_msgs::Part> &available = available_[part.name];
+        for (int i = available.size() - 1; i >= 0; i--) {
+            if (same_part(available[i], part)) {
+                available.erase(available.begin() + i);
+                break;
+            }
+        }
+        stale_ = true;
+    }
+
+    //rescan if any part was picked since the latest scan; meant for when the robot has nothing else to do;
+    // returns true if it scanned
+    bool refresh_if_stale() {
+        if (!stale_) return false;
+        scan();
+        return true;
+    }
+
+private:
+    BinInventory *bin_inventory_;
+    bool have_snapshot_;
+    bool stale_; //parts were picked since the latest scan
+    inventory_msgs::Inventory snapshot_;
+    std::map<std::string, vector<inventory_msgs::Part> > available_; //by part type; picked parts removed
+
+    static bool same_part(const inventory_msgs::Part &a, const inventory_msgs::Part &b) {
+        if (a.location != b.location || a.name != b.name) return false;
+        double dx = a.pose.pose.position.x - b.pose.pose.position.x;
+        double dy = a.pose.pose.position.y - b.pose.pose.position.y;
+        return dx * dx + dy * dy < PICKED_PART_MATCH_DISTANCE * PICKED_PART_MATCH_DISTANCE;
+    }
+
+    //scan the bins and index the result by part type; every part picked so far is gone from it
+    void scan() {
+        LATENCY_SCOPE("unload/bin_scan");
+        bin_inventory_->update();
+        bin_inventory_->get_inventory(snapshot_);
+        have_snapshot_ = true;
+        stale_ = false;
+        for (std::map<std::string, vector<inventory_msgs::Part> >::iterator it = available_.begin();
+                it != available_.end(); ++it) {
+            it->second.clear(); //keeps each list's storage
+        }
+        for (int i = 0; i < (int) snapshot_.inventory.size(); i++) {
+            const vector<inventory_msgs::Part> &parts = snapshot_.inventory[i].part;
+            for (int j = 0; j < (int) parts.size(); j++) available_[parts[j].name].push_back(parts[j]);
+        }
+    }
+};
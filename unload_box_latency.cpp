@@ -0,0 +1,68 @@
+//unload_box_latency.cpp: periodic dump of the process's latency stats (latency_stats.h)
+// this file is included by unload_box_v4.cpp
+//every latency_stats/period seconds (param; default 30, 0 disables the periodic dump) the summary of every
+// stage and counter so far, inspector and unloader alike, is published on the topic latency_stats
+// (std_msgs/String) and, if the param latency_stats/file names a file, written to that file (replacing
+// the previous dump); dump() may also be called directly, e.g. once more at the end of the run, after
+// stop(), so the final dump is the last one written
+
+#include <condition_variable>
+#include <fstream>
+#include <thread>
+
+const double LATENCY_DUMP_PERIOD = 30.0; //(sec)
+
+class LatencyStatsDumper {
+public:
+    LatencyStatsDumper(ros::NodeHandle &nh) : stop_(false) {
+        nh.param("latency_stats/period", period_, LATENCY_DUMP_PERIOD);
+        nh.param<std::string>("latency_stats/file", path_, "");
+        publisher_ = nh.advertise<std_msgs::String>("latency_stats", 1, true); //latched: the latest dump
+        if (period_ > 0.0) thread_ = std::thread(&LatencyStatsDumper::dump_periodically, this);
+    }
+
+    ~LatencyStatsDumper() {
+        stop();
+    }
+
+    //end the periodic dumps; returns once the dump thread has exited
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        stop_requested_.notify_all();
+        if (thread_.joinable()) thread_.join();
+    }
+
+    //safe to call from any thread; concurrent dumps are written one at a time
+    void dump() {
+        std::lock_guard<std::mutex> lock(dump_mutex_);
+        std_msgs::String msg;
+        msg.data = latency_stats().summary();
+        publisher_.publish(msg);
+        if (!path_.empty()) {
+            std::ofstream out(path_.c_str(), std::ios::trunc);
+            out << msg.data;
+        }
+    }
+
+private:
+    double period_;
+    std::string path_;
+    ros::Publisher publisher_;
+    std::thread thread_;
+    std::mutex mutex_; //guards stop_
+    std::mutex dump_mutex_; //one dump at a time
+    std::condition_variable stop_requested_;
+    bool stop_;
+
+    void dump_periodically() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_requested_.wait_for(lock, std::chrono::duration<double>(period_), [this]() { return stop_; })) {
+            lock.unlock();
+            dump();
+            lock.lock();
+        }
+    }
+};
@@ -0,0 +1,80 @@
+//unload_box_orders.cpp: queue of every shipment received on ariac/orders, handed out by priority
+// this file is included by unload_box_v4.cpp
+//orders may arrive at any time during the competition; an order received later is served first (mid-run
+// orders carry the higher priority multiplier), and within an order, shipments with fewer products go
+// first, so that the most shipments are complete if time runs out
+//an order re-sent under an existing order_id replaces that order's shipments not yet started
+
+#include <algorithm>
+
+struct ScheduledShipment {
+    std::string order_id;
+    int order_seq; //0 for the first order received, 1 for the next, ...
+    int shipment_index; //position within its order
+    osrf_gear::Shipment shipment;
+};
+
+//true if a should be filled before b
+bool shipment_precedes(const ScheduledShipment &a, const ScheduledShipment &b) {
+    if (a.order_seq != b.order_seq) return a.order_seq > b.order_seq;
+    if (a.shipment.products.size() != b.shipment.products.size()) return a.shipment.products.size() < b.shipment.products.size();
+    return a.shipment_index < b.shipment_index;
+}
+
+class OrderScheduler {
+public:
+    OrderScheduler() : n_orders_received_(0), closed_(false) {}
+
+    //queue all shipments of an order (from the orders callback)
+    void add_order(const osrf_gear::Order &order) {
+        int order_seq = n_orders_received_++;
+        //drop not-yet-started shipments of an earlier version of this order
+        for (int i = pending_.size() - 1; i >= 0; i--) {
+            if (pending_[i].order_id == order.order_id) {
+                ROS_WARN("order %s updated; replacing its pending shipment %s", order.order_id.c_str(),
+                        pending_[i].shipment.shipment_type.c_str());
+                pending_.erase(pending_.begin() + i);
+            }
+        }
+        for (int i = 0; i < (int) order.shipments.size(); i++) {
+            ScheduledShipment scheduled;
+            scheduled.order_id = order.order_id;
+            scheduled.order_seq = order_seq;
+            scheduled.shipment_index = i;
+            scheduled.shipment = order.shipments[i];
+            pending_.push_back(scheduled);
+        }
+        std::stable_sort(pending_.begin(), pending_.end(), shipment_precedes);
+        ROS_INFO("scheduler: %d shipments pending", (int) pending_.size());
+    }
+
+    bool has_pending() const {
+        return !pending_.empty();
+    }
+
+    //remove and return the highest-priority shipment; returns false if none is pending
+    bool next_shipment(ScheduledShipment &next) {
+        if (pending_.empty()) return false;
+        next = pending_.front();
+        pending_.erase(pending_.begin());
+        return true;
+    }
+
+    //no more orders will arrive (e.g. the competition is over)
+    void close() {
+        closed_ = true;
+    }
+
+    bool closed() const {
+        return closed_;
+    }
+
+    int n_orders_received() const {
+        return n_orders_received_;
+    }
+
+private:
+    vector<ScheduledShipment> pending_; //highest priority first
+    int n_orders_received_;
+    bool closed_;
+};
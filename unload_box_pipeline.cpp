@@ -0,0 +1,576 @@
+//unload_box_pipeline.cpp: pipelined shipment filling, using all inspection stations at once
+// this file is included by unload_box_v4.cpp
+//each box is filled at the first station (Q1), then moved station by station (quality sensors further
+// down may find more bad parts), corrected at each, and shipped; while the robot corrects the box at one
+// station, the conveyor brings the next box up or carries a finished box on, so the robot is rarely
+// left waiting on the conveyor
+//stations come from the inspector's station table (inspection_station_config()); each runs the same
+// state machine: EMPTY -> LOCATING_BOX (box arrived) -> CORRECTING (inspected) -> FINISHED (planner says
+// ship) -> EMPTY (conveyor leg to the next station or the depot started); a CORRECTING box goes back to
+// LOCATING_BOX whenever a conveyor leg completes (see below)
+//robot actions are interleaved between stations one correction at a time, each followed by a
+// re-inspection of that station; the exception is orphans (incl. bad parts): as many as there is time
+// for are discarded back-to-back, in an order that keeps the arm's travel short, as one batch validated
+// by a single inspection at its end
+//shipments are taken from an OrderScheduler as boxes become free; as the competition deadline nears,
+// no new boxes are started, and a CorrectionPlanner picks which corrections are still worth making to
+// the boxes already on the line, so that they are shipped in time
+//in dry-run mode, conveyor legs complete at once without being commanded, each box is inspected once and
+// the corrections the planner would make are reported, and no robot or drone command is sent
+//during a conveyor leg, the robot does not touch the station the leg feeds (nor, as it has left, the one
+// the leg started from), but keeps working at every other station; the conveyor is a single belt, though,
+// so a leg may still nudge a box parked elsewhere: after every leg, each box being corrected is located
+// again, and if it has moved its desired part poses are recomputed before any further correction; a box
+// that cannot be seen again is shipped as is, rather than corrected at a pose it may no longer have
+
+const double PIPELINE_POLL_PERIOD = 0.1; //(sec) idle wait, when neither robot nor conveyor has work
+const int MAX_CORRECTIONS_PER_BOX = 30; //give up on perfecting a box after this many robot actions
+const int MAX_BOX_LOCATE_ATTEMPTS = 5; //then assume a new box's nominal pose, or ship a moved box as is
+//time estimates used to leave enough time for shipping before the deadline (conveyor legs are measured)
+const double DRONE_CALL_TIME_ESTIMATE = 5.0; //(sec) from arrival at the depot to pickup by the drone
+const double MIN_BOX_FILL_TIME = 60.0; //(sec) don't start a new box with less time than this to fill it
+
+const int NO_CONVEYOR_LEG = -1;
+
+//what a station is doing with its box
+enum StationStage {
+    STATION_EMPTY, //no box here
+    STATION_LOCATING_BOX, //box just arrived; pose and desired part poses not yet known
+    STATION_CORRECTING, //inspected; robot has work to do here
+    STATION_FINISHED //nothing more to do; waiting for the conveyor to carry the box on
+};
+
+//one box, from the time it is requested until it is shipped
+struct BoxJob {
+    std::string order_id;
+    osrf_gear::Shipment shipment;
+    geometry_msgs::PoseStamped box_pose_wrt_world;
+    vector<osrf_gear::Model> desired_models_wrt_world; //at the box's current station
+    vector<char> abandoned; //per desired part: gave up fetching it (e.g. none in inventory)
+    int n_corrections; //robot actions spent on this box at its current station
+    bool box_located; //box_pose_wrt_world and desired_models_wrt_world are valid at the current station
+};
+
+struct InspectionStation {
+    const InspectionStationConfig *config; //camera, quality sensor, nominal box pose, ...
+    int legs_to_depot; //conveyor legs from this station to the drone depot
+    StationStage stage;
+    int n_locate_attempts;
+    BoxJob job;
+    //results of the latest update_inspection() at this station
+    vector<osrf_gear::Model> satisfied_models_wrt_world;
+    vector<osrf_gear::Model> misplaced_models_actual_coords_wrt_world;
+    vector<osrf_gear::Model> misplaced_models_desired_coords_wrt_world;
+    vector<osrf_gear::Model> missing_models_wrt_world;
+    vector<osrf_gear::Model> orphan_models_wrt_world;
+    vector<int> part_indices_missing;
+    vector<int> part_indices_misplaced;
+    vector<int> part_indices_precisely_placed;
+};
+
+class ShipmentPipeline {
+public:
+    ShipmentPipeline(RobotBehaviorInterface *robot, ConveyorInterface *conveyor, BoxInspector2 *inspector,
+            BinInventory *bin_inventory, ros::ServiceClient *drone_client, OrderScheduler *scheduler);
+
+    //time by which every box must be shipped
+    void set_deadline(ros::Time deadline);
+
+    //fill and ship scheduled shipments, one box each; returns when nothing is left to do and no more
+    // shipments can be (or will be) scheduled, or when ROS shuts down
+    void run();
+
+private:
+    RobotBehaviorInterface *robot_;
+    ConveyorInterface *conveyor_;
+    BoxInspector2 *inspector_;
+    BinInventory *bin_inventory_;
+    ros::ServiceClient *drone_client_;
+    OrderScheduler *scheduler_;
+    ros::Time deadline_;
+
+    vector<InspectionStation> stations_; //in conveyor order
+    CorrectionPlanner planner_;
+    BinInventoryCache inventory_cache_;
+    KeyPoseCache key_pose_cache_;
+    int leg_in_progress_; //destination of the conveyor leg in progress: a station index, depot_index(),
+                          // or NO_CONVEYOR_LEG; at most one leg is in progress at a time
+    ros::Time leg_start_time_;
+    BoxJob box_in_transit_; //box being moved by the leg in progress
+    bool box_at_depot_; //box_in_transit_ has reached the depot and waits for the drone
+    int n_shipped_;
+
+    double time_left() const;
+    double time_to_ship(const InspectionStation &station) const;
+    bool have_time_for_new_box() const;
+    bool line_empty() const;
+    int depot_index() const;
+    void command_conveyor_leg(int destination);
+    int conveyor_status_at(int destination) const;
+    void start_leg_from(InspectionStation &station, int destination);
+    void start_conveyor_leg();
+    void check_conveyor_leg();
+    void relocate_parked_boxes();
+    void call_drone();
+    void locate_box(InspectionStation &station);
+    void inspect(InspectionStation &station);
+    bool fed_by_leg(int i_station) const;
+    int choose_station() const;
+    void perform_next_correction(InspectionStation &station);
+    bool discard_orphans(InspectionStation &station, double time_budget, int &n_discarded);
+    bool reposition_misplaced_part(InspectionStation &station);
+    bool fill_missing_part(InspectionStation &station, int i_desired);
+};
+
+ShipmentPipeline::ShipmentPipeline(RobotBehaviorInterface *robot, ConveyorInterface *conveyor,
+        BoxInspector2 *inspector, BinInventory *bin_inventory, ros::ServiceClient *drone_client,
+        OrderScheduler *scheduler) :
+        robot_(robot), conveyor_(conveyor), inspector_(inspector), bin_inventory_(bin_inventory),
+        drone_client_(drone_client), scheduler_(scheduler), inventory_cache_(bin_inventory),
+        leg_in_progress_(NO_CONVEYOR_LEG),
+        box_at_depot_(false), n_shipped_(0) {
+    int n_stations = num_inspection_stations();
+    stations_.resize(n_stations);
+    for (int i = 0; i < n_stations; i++) {
+        stations_[i].config = inspection_station_config(i + 1);
+        stations_[i].legs_to_depot = n_stations - i;
+        stations_[i].stage = STATION_EMPTY;
+        stations_[i].n_locate_attempts = 0;
+    }
+}
+
+void ShipmentPipeline::set_deadline(ros::Time deadline) {
+    deadline_ = deadline;
+}
+
+double ShipmentPipeline::time_left() const {
+    return (deadline_ - ros::Time::now()).toSec();
+}
+
+//estimated time to carry a box from this station to the depot and have it picked up
+double ShipmentPipeline::time_to_ship(const InspectionStation &station) const {
+    return station.legs_to_depot * planner_.conveyor_leg_duration() + DRONE_CALL_TIME_ESTIMATE;
+}
+
+bool ShipmentPipeline::have_time_for_new_box() const {
+    return time_left() > planner_.conveyor_leg_duration() + MIN_BOX_FILL_TIME + time_to_ship(stations_[0]);
+}
+
+//no box anywhere between the start of the conveyor and the drone
+bool ShipmentPipeline::line_empty() const {
+    if (leg_in_progress_ != NO_CONVEYOR_LEG || box_at_depot_) return false;
+    for (int i = 0; i < (int) stations_.size(); i++) {
+        if (stations_[i].stage != STATION_EMPTY) return false;
+    }
+    return true;
+}
+
+int ShipmentPipeline::depot_index() const {
+    return stations_.size();
+}
+
+//ConveyorInterface has one goal per leg, for a line of two stations
+void ShipmentPipeline::command_conveyor_leg(int destination) {
+    if (dry_run()) return;
+    if (destination == depot_index()) {
+        conveyor_->move_box_Q2_to_drone_depot();
+    } else if (destination == 0) {
+        conveyor_->move_new_box_to_Q1();
+    } else {
+        conveyor_->move_box_Q1_to_Q2();
+    }
+}
+
+//conveyor status reported when a leg to this destination is complete
+int ShipmentPipeline::conveyor_status_at(int destination) const {
+    if (destination == depot_index()) return conveyor_as::conveyorResult::BOX_SENSED_AT_DRONE_DEPOT;
+    if (destination == 0) return conveyor_as::conveyorResult::BOX_SEEN_AT_Q1;
+    return conveyor_as::conveyorResult::BOX_SEEN_AT_Q2;
+}
+
+//a box leaves its station when its leg starts
+void ShipmentPipeline::start_leg_from(InspectionStation &station, int destination) {
+    ROS_INFO("pipeline: advancing box from %s to %s", station.config->name,
+            destination == depot_index() ? "the drone depot" : stations_[destination].config->name);
+    box_in_transit_ = station.job;
+    station.stage = STATION_EMPTY;
+    leg_in_progress_ = destination;
+    leg_start_time_ = ros::Time::now();
+    command_conveyor_leg(destination);
+}
+
+//issue the most downstream conveyor leg that is possible now
+//consecutive legs always differ, so the conveyor's status can never be mistaken for the result of the
+// previous leg
+void ShipmentPipeline::start_conveyor_leg() {
+    if (leg_in_progress_ != NO_CONVEYOR_LEG || box_at_depot_) return;
+    for (int i = stations_.size() - 1; i >= 0; i--) {
+        if (stations_[i].stage != STATION_FINISHED) continue;
+        if (i + 1 == depot_index() || stations_[i + 1].stage == STATION_EMPTY) {
+            start_leg_from(stations_[i], i + 1);
+            return;
+        }
+    }
+    if (stations_[0].stage == STATION_EMPTY && scheduler_->has_pending() && have_time_for_new_box()) {
+        ScheduledShipment next;
+        scheduler_->next_shipment(next);
+        ROS_INFO("pipeline: getting a new box into position at %s for shipment %s of order %s",
+                stations_[0].config->name, next.shipment.shipment_type.c_str(), next.order_id.c_str());
+        box_in_transit_.order_id = next.order_id;
+        box_in_transit_.shipment = next.shipment;
+        leg_in_progress_ = 0;
+        leg_start_time_ = ros::Time::now();
+        command_conveyor_leg(0);
+    }
+}
+
+void ShipmentPipeline::check_conveyor_leg() {
+    if (leg_in_progress_ == NO_CONVEYOR_LEG) return;
+    int destination = leg_in_progress_;
+    if (!dry_run() && conveyor_->get_box_status() != conveyor_status_at(destination)) return;
+    leg_in_progress_ = NO_CONVEYOR_LEG;
+    double leg_duration = (ros::Time::now() - leg_start_time_).toSec();
+    planner_.record_conveyor_leg(leg_duration);
+    LATENCY_RECORD_SECONDS("conveyor/leg", leg_duration);
+    if (destination == depot_index()) {
+        ROS_INFO("pipeline: box arrived at the drone depot");
+        box_at_depot_ = true;
+        relocate_parked_boxes();
+        return;
+    }
+    InspectionStation &station = stations_[destination];
+    ROS_INFO("pipeline: box arrived at %s", station.config->name);
+    station.job = box_in_transit_;
+    station.job.box_located = false;
+    station.stage = STATION_LOCATING_BOX;
+    station.n_locate_attempts = 0;
+    relocate_parked_boxes();
+}
+
+//the belt has just moved every box on it; look again for each box the robot is still working on
+// (finished boxes are only carried on, so their pose no longer matters)
+void ShipmentPipeline::relocate_parked_boxes() {
+    for (int i = 0; i < (int) stations_.size(); i++) {
+        InspectionStation &station = stations_[i];
+        if (station.stage != STATION_CORRECTING) continue;
+        station.stage = STATION_LOCATING_BOX;
+        station.n_locate_attempts = 0;
+    }
+}
+
+void ShipmentPipeline::call_drone() {
+    if (!box_at_depot_) return;
+    osrf_gear::DroneControl droneControl;
+    droneControl.request.shipment_type = box_in_transit_.shipment.shipment_type;
+    droneControl.response.success = false;
+    STEP_POINT("ship", "calling the drone");
+    if (dry_run()) {
+        droneControl.response.success = true;
+    } else {
+        LATENCY_SCOPE("drone/call");
+        drone_client_->call(droneControl);
+    }
+    if (!droneControl.response.success) return; //try again next cycle
+    ROS_INFO_STREAM("pipeline: shipped " << box_in_transit_.shipment.shipment_type << " of order "
+            << box_in_transit_.order_id << endl);
+    box_at_depot_ = false;
+    n_shipped_++;
+    LATENCY_COUNT("unload/boxes_shipped", 1);
+}
+
+//find the box at this station, either just arrived or possibly moved by a conveyor leg, and compute where
+// its parts should be
+void ShipmentPipeline::locate_box(InspectionStation &station) {
+    BoxJob &job = station.job;
+    STEP_POINT("locate_box", "getting box pose");
+    station.n_locate_attempts++;
+    //on failure, get_box_pose_wrt_world() leaves the nominal box pose for this station
+    geometry_msgs::PoseStamped box_pose_wrt_world;
+    bool box_seen;
+    {
+        LATENCY_SCOPE("unload/box_pose");
+        box_seen = inspector_->get_box_pose_wrt_world(box_pose_wrt_world, station.config->cam_num);
+    }
+    if (box_seen) {
+        ROS_INFO_STREAM(station.config->name << ": box seen at: " << box_pose_wrt_world << endl);
+    } else if (station.n_locate_attempts < MAX_BOX_LOCATE_ATTEMPTS) {
+        ROS_WARN("%s: no box seen yet", station.config->name);
+        return;
+    } else if (job.box_located) {
+        //a conveyor leg may have carried it out of view; its last known pose cannot be trusted
+        ROS_WARN("%s: box lost after a conveyor leg; shipping it as is", station.config->name);
+        LATENCY_COUNT("unload/boxes_lost", 1);
+        station.stage = STATION_FINISHED;
+        return;
+    } else {
+        ROS_WARN("%s: box never seen; assuming its nominal pose", station.config->name);
+    }
+    //the box contents may have shifted along with the box; frames so far may show either
+    reset_inspection_cache(station.config->cam_num);
+    if (job.box_located) {
+        if (same_box_pose(job.box_pose_wrt_world.pose, box_pose_wrt_world.pose)) {
+            inspect(station);
+            return;
+        }
+        ROS_WARN("%s: box moved during a conveyor leg; recomputing its desired part poses", station.config->name);
+        LATENCY_COUNT("unload/boxes_moved", 1);
+    }
+    job.box_pose_wrt_world = box_pose_wrt_world;
+    compute_shipment_poses_from_template(*inspector_, job.shipment, job.box_pose_wrt_world, job.desired_models_wrt_world);
+    if (!job.box_located) { //new at this station; a box that merely moved keeps its history
+        job.abandoned.assign(job.desired_models_wrt_world.size(), 0);
+        job.n_corrections = 0;
+        job.box_located = true;
+    }
+    inspect(station);
+}
+
+void ShipmentPipeline::inspect(InspectionStation &station) {
+    STEP_POINT("inspect", "inspecting box");
+    LATENCY_SCOPE("unload/inspect");
+    inspector_->update_inspection(station.job.desired_models_wrt_world,
+            station.satisfied_models_wrt_world, station.misplaced_models_actual_coords_wrt_world,
+            station.misplaced_models_desired_coords_wrt_world, station.missing_models_wrt_world,
+            station.orphan_models_wrt_world, station.part_indices_missing, station.part_indices_misplaced,
+            station.part_indices_precisely_placed, station.config->cam_num);
+    ROS_INFO("%s: %d orphaned, %d misplaced, %d missing, %d precisely placed", station.config->name,
+            (int) station.orphan_models_wrt_world.size(), (int) station.part_indices_misplaced.size(),
+            (int) station.part_indices_missing.size(), (int) station.part_indices_precisely_placed.size());
+    station.stage = STATION_CORRECTING;
+}
+
+//true if the conveyor leg in progress is bringing a box to station i_station; no robot work there until
+// the box has arrived
+bool ShipmentPipeline::fed_by_leg(int i_station) const {
+    return leg_in_progress_ == i_station;
+}
+
+//the station where the robot should act next, or -1 if none has work;
+//the most downstream box goes first: finishing it frees the conveyor for the boxes behind it
+int ShipmentPipeline::choose_station() const {
+    for (int i = stations_.size() - 1; i >= 0; i--) {
+        if (stations_[i].stage == STATION_CORRECTING && !fed_by_leg(i)) return i;
+    }
+    return -1;
+}
+
+//one robot action at this station, chosen by the planner from the latest inspection and the time left
+// for this box; orphans (including bad parts) are removed first, then misplaced parts are repositioned,
+// then missing parts are fetched; the station is re-inspected afterwards
+void ShipmentPipeline::perform_next_correction(InspectionStation &station) {
+    BoxJob &job = station.job;
+    if (job.n_corrections >= MAX_CORRECTIONS_PER_BOX) {
+        ROS_WARN("%s: giving up on this box after %d corrections", station.config->name, job.n_corrections);
+        station.stage = STATION_FINISHED;
+        return;
+    }
+    int i_missing = -1;
+    int n_missing = 0; //not abandoned
+    for (int i = 0; i < (int) station.part_indices_missing.size(); i++) {
+        if (job.abandoned[station.part_indices_missing[i]]) continue;
+        if (i_missing < 0) i_missing = station.part_indices_missing[i];
+        n_missing++;
+    }
+    double time_budget = time_left() - time_to_ship(station);
+    int kind = planner_.plan(station.orphan_models_wrt_world.size(), station.part_indices_misplaced.size(),
+            n_missing, job.shipment.products.size(), time_budget);
+    if (dry_run()) {
+        ROS_INFO("%s (dry run): %.1f sec left for this box; next correction would be %d", station.config->name, time_budget, kind);
+        station.stage = STATION_FINISHED;
+        return;
+    }
+    if (kind < 0) {
+        if (station.orphan_models_wrt_world.empty() && station.part_indices_misplaced.empty() && n_missing == 0) {
+            ROS_INFO("%s: done with this box", station.config->name);
+        } else {
+            ROS_WARN("%s: %.1f sec left for this box; shipping it as is", station.config->name, time_budget);
+        }
+        station.stage = STATION_FINISHED;
+        return;
+    }
+
+    ros::Time start_time = ros::Time::now();
+    bool success;
+    int n_actions = 1;
+    switch (kind) {
+        case CORRECTION_DISCARD_ORPHAN: {
+            LATENCY_SCOPE("unload/discard_orphans");
+            success = discard_orphans(station, time_budget, n_actions);
+            break;
+        }
+        case CORRECTION_REPOSITION: {
+            LATENCY_SCOPE("unload/reposition");
+            success = reposition_misplaced_part(station);
+            break;
+        }
+        default: {
+            LATENCY_SCOPE("unload/fill_missing");
+            success = fill_missing_part(station, i_missing);
+            if (job.abandoned[i_missing]) return; //not in inventory; no robot action taken
+            break;
+        }
+    }
+    job.n_corrections += n_actions;
+    LATENCY_COUNT("unload/corrections", n_actions);
+    if (!success) LATENCY_COUNT("unload/failed_corrections", 1);
+    inspect(station);
+    //a batch counts as n_actions corrections of equal duration
+    double duration = (ros::Time::now() - start_time).toSec() / n_actions;
+    for (int i = 0; i < n_actions; i++) planner_.record_correction((CorrectionKind) kind, duration, success);
+}
+
+//discard the orphans found by the latest inspection (bad parts included) back-to-back, as many as fit in
+// time_budget (at least one), ordered by order_picks(); the box is not re-inspected between picks unless
+// one fails, in which case the rest of the batch is re-planned from a fresh inspection;
+//n_discarded is set to the number of discard attempts; returns false if any of them failed
+bool ShipmentPipeline::discard_orphans(InspectionStation &station, double time_budget, int &n_discarded) {
+    int batch_limit = time_budget / planner_.correction_duration(CORRECTION_DISCARD_ORPHAN);
+    batch_limit = std::min(std::max(batch_limit, 1), MAX_CORRECTIONS_PER_BOX - station.job.n_corrections);
+    bool success = true;
+    vector<geometry_msgs::Pose> orphan_poses;
+    vector<int> order;
+    inventory_msgs::Part current_part;
+    n_discarded = 0;
+    while (n_discarded < batch_limit && !station.orphan_models_wrt_world.empty()) {
+        const vector<osrf_gear::Model> &orphans = station.orphan_models_wrt_world;
+        orphan_poses.resize(orphans.size());
+        for (int i = 0; i < (int) orphans.size(); i++) orphan_poses[i] = orphans[i].pose;
+        order_picks(orphan_poses, station.job.box_pose_wrt_world.pose.position, order);
+        bool batch_failed = false;
+        for (int k = 0; k < (int) order.size() && n_discarded < batch_limit; k++) {
+            inspector_->model_to_part(orphans[order[k]], current_part, station.config->location_code);
+            ROS_INFO("%s: removing orphaned part %d of %d: ", station.config->name, k + 1, (int) order.size());
+            ROS_INFO_STREAM(current_part << endl);
+            STEP_POINT("remove_orphan", "removing orphaned part");
+            bool discarded;
+            {
+                LATENCY_SCOPE("robot/pick_from_box");
+                discarded = robot_->pick_part_from_box(current_part);
+            }
+            {
+                LATENCY_SCOPE("robot/discard");
+                discarded = robot_->discard_grasped_part(current_part) && discarded;
+            }
+            note_box_action(station.config->cam_num, current_part.name);
+            n_discarded++;
+            if (!discarded) {
+                //the part may have been dropped back into the box, disturbing others; look again
+                ROS_WARN("%s: failed to discard orphan; re-inspecting", station.config->name);
+                success = false;
+                batch_failed = true;
+                break;
+            }
+        }
+        if (!batch_failed) break; //validated by the caller's inspection
+        inspect(station);
+    }
+    return success;
+}
+
+bool ShipmentPipeline::reposition_misplaced_part(InspectionStation &station) {
+    inventory_msgs::Part current_part, desired_part;
+    inspector_->model_to_part(station.misplaced_models_actual_coords_wrt_world[0], current_part, station.config->location_code);
+    int index_des_part = station.part_indices_misplaced[0];
+    inspector_->model_to_part(station.job.desired_models_wrt_world[index_des_part], desired_part, station.config->location_code);
+    ROS_INFO("%s: move part from: ", station.config->name);
+    ROS_INFO_STREAM(current_part);
+    ROS_INFO("%s: move part to: ", station.config->name);
+    ROS_INFO_STREAM(desired_part);
+    STEP_POINT("reposition", "repositioning part");
+    bool success = robot_->pick_part_from_box(current_part);
+    //following fnc works ONLY if part is already grasped:
+    success = robot_->adjust_part_location_no_release(current_part, desired_part) && success;
+    robot_->release_and_retract();
+    note_box_action(station.config->cam_num, current_part.name);
+    return success;
+}
+
+//fetch desired part i_desired from the bins and place it in the box;
+//returns false if this failed; if no such part is in inventory, or parts of its type from its bin have
+// already been found unable to reach its slot, also marks the part abandoned
+bool ShipmentPipeline::fill_missing_part(InspectionStation &station, int i_desired) {
+    BoxJob &job = station.job;
+    std::string part_name(job.desired_models_wrt_world[i_desired].type);
+    ROS_INFO_STREAM(station.config->name << ": looking for part " << part_name << endl);
+    inventory_msgs::Part pick_part, place_part;
+
+    //find the part needing to be placed; the cache rescans the bins only when it must
+    bool found;
+    {
+        LATENCY_SCOPE("unload/find_part");
+        found = inventory_cache_.find_part(part_name, pick_part);
+    }
+    if (!found) {
+        ROS_WARN("%s: could not find desired part in inventory; shipping without it", station.config->name);
+        job.abandoned[i_desired] = 1;
+        return false;
+    }
+    ROS_INFO_STREAM(station.config->name << ": found part: " << pick_part << endl);
+    inspector_->model_to_part(job.desired_models_wrt_world[i_desired], place_part, station.config->location_code);
+
+    //products are listed w/rt the box, in the same order as the desired models
+    KeyPoseVerdict key_poses = key_pose_cache_.evaluate(robot_, pick_part, place_part,
+            job.shipment.products[i_desired].pose, job.box_pose_wrt_world.pose);
+    if (key_poses == KEY_POSES_KNOWN_INFEASIBLE) {
+        //not re-evaluated, so the server holds no key poses for this part; picking now would use stale ones
+        ROS_WARN("%s: this part cannot be moved into its slot; shipping without it", station.config->name);
+        job.abandoned[i_desired] = 1;
+        return false;
+    }
+    if (key_poses == KEY_POSES_INFEASIBLE) {
+        ROS_WARN("%s: could not compute key pickup and place poses for this part source and destination", station.config->name);
+    }
+    STEP_POINT("pick", "picking part from bin");
+    bool picked;
+    {
+        LATENCY_SCOPE("robot/pick_from_bin");
+        picked = robot_->pick_part_from_bin(pick_part);
+    }
+    inventory_cache_.note_picked(pick_part); //even a failed pick may have moved the part
+    if (!picked) {
+        ROS_WARN("%s: pick failed", station.config->name); //retried, up to the box's correction limit
+        return false;
+    }
+    if (!robot_->move_part_to_approach_pose(place_part)) {
+        ROS_WARN("%s: could not move to approach pose", station.config->name);
+        robot_->discard_grasped_part(place_part);
+        return false;
+    }
+    STEP_POINT("place", "placing part in box");
+    bool success;
+    {
+        LATENCY_SCOPE("robot/place");
+        success = robot_->place_part_in_box_no_release(place_part);
+    }
+    if (!success) {
+        ROS_WARN("%s: placement failed", station.config->name);
+        robot_->discard_grasped_part(place_part);
+    } else {
+        robot_->release_and_retract();
+    }
+    note_box_action(station.config->cam_num, place_part.name);
+    return success;
+}
+
+void ShipmentPipeline::run() {
+    while (ros::ok()) {
+        ros::spinOnce(); //also receives new orders
+        if (line_empty()) {
+            if (!have_time_for_new_box()) break;
+            if (scheduler_->closed() && !scheduler_->has_pending()) break;
+        }
+        check_conveyor_leg();
+        call_drone();
+        start_conveyor_leg(); //conveyor moves while the robot works below
+        for (int i = 0; i < (int) stations_.size(); i++) {
+            if (stations_[i].stage == STATION_LOCATING_BOX && !fed_by_leg(i)) locate_box(stations_[i]);
+        }
+        int i_station = choose_station();
+        if (i_station >= 0) {
+            perform_next_correction(stations_[i_station]);
+        } else if (!inventory_cache_.refresh_if_stale()) { //robot idle: a bin scan costs nothing now
+            ros::Duration(PIPELINE_POLL_PERIOD).sleep();
+        }
+    }
+    ROS_INFO("pipeline: shipped %d boxes", n_shipped_);
+}
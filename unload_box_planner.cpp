@@ -0,0 +1,174 @@
+//unload_box_planner.cpp: deadline-aware choice of corrective actions
+// this file is included by unload_box_v4.cpp
+//every robot correction (and every conveyor leg) is timed; the planner keeps running estimates of
+// duration and success rate per kind of action, and, given the current inspection of a box and the time
+// left before the box must leave for the drone, picks the set of corrections with the highest expected
+// score that fits in that time; the box is shipped when the best set is empty
+//order_picks() orders a batch of picks from a box to keep the arm's travel short
+
+//kinds of corrective action, in the order they are performed
+enum CorrectionKind {
+    CORRECTION_DISCARD_ORPHAN, //remove a part that does not belong (incl. bad parts)
+    CORRECTION_REPOSITION, //move a misplaced part to its desired pose
+    CORRECTION_FETCH_MISSING, //bring a missing part from the bins
+    NUM_CORRECTION_KINDS
+};
+
+//score gained per successful correction, after the scoring of a shipment: a part of the right type in
+// the box and a part in the right pose are a point each; removing an orphan gains nothing directly,
+// but is needed for the shipment to be complete (and a bad part usually blocks a slot)
+const double CORRECTION_VALUE[NUM_CORRECTION_KINDS] = {0.5, 1.0, 2.0};
+const double COMPLETE_SHIPMENT_BONUS_PER_PART = 1.0; //all products present and correct
+
+//priors, used until measurements are available; measured durations include the re-inspection that follows
+const double PRIOR_CORRECTION_DURATION[NUM_CORRECTION_KINDS] = {15.0, 20.0, 40.0}; //(sec)
+const double PRIOR_CONVEYOR_LEG_DURATION = 15.0; //(sec) one conveyor leg, e.g. Q1 to Q2
+const double PRIOR_SUCCESS_RATE = 0.9;
+const double PRIOR_WEIGHT = 2.0; //priors count as this many observations
+
+//running mean of a measured quantity, started from a prior
+class RunningEstimate {
+public:
+    RunningEstimate(double prior = 0.0) : sum_(prior * PRIOR_WEIGHT), weight_(PRIOR_WEIGHT) {}
+
+    void add(double value) {
+        sum_ += value;
+        weight_ += 1.0;
+    }
+
+    double mean() const {
+        return sum_ / weight_;
+    }
+
+private:
+    double sum_;
+    double weight_;
+};
+
+class CorrectionPlanner {
+public:
+    CorrectionPlanner() : conveyor_leg_duration_(PRIOR_CONVEYOR_LEG_DURATION) {
+        for (int k = 0; k < NUM_CORRECTION_KINDS; k++) {
+            duration_[k] = RunningEstimate(PRIOR_CORRECTION_DURATION[k]);
+            success_[k] = RunningEstimate(PRIOR_SUCCESS_RATE);
+        }
+    }
+
+    void record_correction(CorrectionKind kind, double duration, bool success) {
+        duration_[kind].add(duration);
+        success_[kind].add(success ? 1.0 : 0.0);
+    }
+
+    void record_conveyor_leg(double duration) {
+        conveyor_leg_duration_.add(duration);
+    }
+
+    double correction_duration(CorrectionKind kind) const {
+        return duration_[kind].mean();
+    }
+
+    double conveyor_leg_duration() const {
+        return conveyor_leg_duration_.mean();
+    }
+
+    //choose the corrections to make to a box with the given numbers of orphans, misplaced parts and
+    // (obtainable) missing parts, within time_budget seconds;
+    //returns the kind of correction to perform next, or -1 if the box should be shipped as is
+    //all combinations of counts are tried; boxes hold few parts, so this is cheap
+    int plan(int n_orphans, int n_misplaced, int n_missing, int n_products, double time_budget) const {
+        const int n_available[NUM_CORRECTION_KINDS] = {n_orphans, n_misplaced, n_missing};
+        double expected_gain[NUM_CORRECTION_KINDS];
+        double duration[NUM_CORRECTION_KINDS];
+        for (int k = 0; k < NUM_CORRECTION_KINDS; k++) {
+            expected_gain[k] = CORRECTION_VALUE[k] * success_[k].mean();
+            duration[k] = duration_[k].mean();
+        }
+        double p_complete = 1.0; //probability of completing the shipment, if every correction is made
+        for (int k = 0; k < NUM_CORRECTION_KINDS; k++) {
+            for (int i = 0; i < n_available[k]; i++) p_complete *= success_[k].mean();
+        }
+        double best_score = 0.0;
+        int best_counts[NUM_CORRECTION_KINDS] = {0, 0, 0};
+        int counts[NUM_CORRECTION_KINDS];
+        for (counts[0] = 0; counts[0] <= n_available[0]; counts[0]++) {
+            for (counts[1] = 0; counts[1] <= n_available[1]; counts[1]++) {
+                for (counts[2] = 0; counts[2] <= n_available[2]; counts[2]++) {
+                    double time_needed = 0.0;
+                    double score = 0.0;
+                    for (int k = 0; k < NUM_CORRECTION_KINDS; k++) {
+                        time_needed += counts[k] * duration[k];
+                        score += counts[k] * expected_gain[k];
+                    }
+                    if (time_needed > time_budget) continue;
+                    if (counts[0] == n_available[0] && counts[1] == n_available[1] && counts[2] == n_available[2]) {
+                        score += p_complete * COMPLETE_SHIPMENT_BONUS_PER_PART * n_products;
+                    }
+                    if (score > best_score) {
+                        best_score = score;
+                        for (int k = 0; k < NUM_CORRECTION_KINDS; k++) best_counts[k] = counts[k];
+                    }
+                }
+            }
+        }
+        for (int k = 0; k < NUM_CORRECTION_KINDS; k++) {
+            if (best_counts[k] > 0) return k;
+        }
+        return -1;
+    }
+
+private:
+    RunningEstimate duration_[NUM_CORRECTION_KINDS];
+    RunningEstimate success_[NUM_CORRECTION_KINDS];
+    RunningEstimate conveyor_leg_duration_;
+};
+
+double pick_distance(const geometry_msgs::Point &a, const geometry_msgs::Point &b) {
+    double dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+    return sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+//order in which to pick parts at the given poses, starting from start, so as to keep the arm's travel
+// short: a nearest-neighbour path, then improved by 2-opt; the path is open (does not return to start);
+//order gets indices into poses; batches are a handful of parts, so the O(n^2) passes are cheap
+void order_picks(const vector<geometry_msgs::Pose> &poses, const geometry_msgs::Point &start, vector<int> &order) {
+    int n = poses.size();
+    order.clear();
+    vector<char> picked(n, 0);
+    geometry_msgs::Point from = start;
+    for (int k = 0; k < n; k++) {
+        int nearest = -1;
+        double nearest_distance = 0.0;
+        for (int i = 0; i < n; i++) {
+            if (picked[i]) continue;
+            double distance = pick_distance(from, poses[i].position);
+            if (nearest < 0 || distance < nearest_distance) {
+                nearest = i;
+                nearest_distance = distance;
+            }
+        }
+        picked[nearest] = 1;
+        order.push_back(nearest);
+        from = poses[nearest].position;
+    }
+    //2-opt: reverse order[i..j] whenever that shortens the path; the edge into order[0] is from start,
+    // and there is no edge out of the last pick
+    bool improved = true;
+    while (improved) {
+        improved = false;
+        for (int i = 0; i < n - 1; i++) {
+            const geometry_msgs::Point &before = (i == 0) ? start : poses[order[i - 1]].position;
+            for (int j = i + 1; j < n; j++) {
+                double old_length = pick_distance(before, poses[order[i]].position);
+                double new_length = pick_distance(before, poses[order[j]].position);
+                if (j + 1 < n) {
+                    old_length += pick_distance(poses[order[j]].position, poses[order[j + 1]].position);
+                    new_length += pick_distance(poses[order[i]].position, poses[order[j + 1]].position);
+                }
+                if (new_length < old_length - 1e-9) {
+                    std::reverse(order.begin() + i, order.begin() + j + 1);
+                    improved = true;
+                }
+            }
+        }
+    }
+}
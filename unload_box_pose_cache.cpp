@@ -0,0 +1,92 @@
+//unload_box_pose_cache.cpp: memoised evaluation of key pick and place poses
+// this file is included by unload_box_v4.cpp
+//evaluate_key_pick_and_place_poses() is asked the same question again and again: the same part type, from
+// the same bin, into the same slot of a box sitting in the same pose at the same station
+//only "infeasible" answers can be memoised: a feasible evaluation also loads the key poses into the
+// behavior server for the pick and place that follow, and RobotBehaviorInterface offers no way to hand
+// previously computed key poses back to the server, so a feasible evaluation is repeated every time; an
+// infeasible one loads nothing usable, so the caller may skip the part without asking again
+//entries are keyed by part type, bin and the slot's pose w/rt the box (quantised); a station's entries
+// are dropped when a box arrives there in a pose that differs from the pose they were computed for by more
+// than a small tolerance
+
+#include <map>
+#include <set>
+#include <sstream>
+
+const double KEY_POSE_POSITION_QUANTUM = 0.005; //(m) slot positions closer than this share a cache entry
+const double KEY_POSE_ORIENTATION_QUANTUM = 0.01; //quaternion components closer than this share an entry
+const double BOX_POSITION_TOLERANCE = 0.01; //(m) box moved further than this: recompute
+const double BOX_ORIENTATION_TOLERANCE = 0.9999; //min |q1.q2|; about 1.6 deg of box rotation
+
+//false if a box has moved or turned by more than the tolerances above between poses a and b
+bool same_box_pose(const geometry_msgs::Pose &a, const geometry_msgs::Pose &b) {
+    double dx = a.position.x - b.position.x;
+    double dy = a.position.y - b.position.y;
+    double dz = a.position.z - b.position.z;
+    if (dx * dx + dy * dy + dz * dz > BOX_POSITION_TOLERANCE * BOX_POSITION_TOLERANCE) return false;
+    double dot = a.orientation.x * b.orientation.x + a.orientation.y * b.orientation.y
+            + a.orientation.z * b.orientation.z + a.orientation.w * b.orientation.w;
+    return fabs(dot) >= BOX_ORIENTATION_TOLERANCE;
+}
+
+enum KeyPoseVerdict {
+    KEY_POSES_LOADED, //evaluated; the server holds key poses for this pick and place
+    KEY_POSES_INFEASIBLE, //evaluated and found infeasible
+    KEY_POSES_KNOWN_INFEASIBLE //found infeasible before; not evaluated again, so the server holds none for it
+};
+
+class KeyPoseCache {
+public:
+    //as robot->evaluate_key_pick_and_place_poses(pick_part, place_part), but skipped when this part type,
+    // from this bin, has already been found infeasible into this slot (slot_pose_wrt_box) of a box in this
+    // pose (box_pose_wrt_world) at this station
+    KeyPoseVerdict evaluate(RobotBehaviorInterface *robot, const inventory_msgs::Part &pick_part,
+            const inventory_msgs::Part &place_part, const geometry_msgs::Pose &slot_pose_wrt_box,
+            const geometry_msgs::Pose &box_pose_wrt_world) {
+        StationEntries &station = stations_[place_part.location];
+        if (!station.have_box_pose || !same_box_pose(station.box_pose_wrt_world, box_pose_wrt_world)) {
+            if (!station.infeasible.empty()) ROS_INFO("box pose changed; dropping cached key pose verdicts");
+            station.infeasible.clear();
+            station.box_pose_wrt_world = box_pose_wrt_world;
+            station.have_box_pose = true;
+        }
+        std::string key = make_key(pick_part, slot_pose_wrt_box);
+        if (station.infeasible.count(key)) {
+            ROS_INFO("key pick and place poses for %s already found infeasible", pick_part.name.c_str());
+            LATENCY_COUNT("unload/key_poses_known_infeasible", 1);
+            return KEY_POSES_KNOWN_INFEASIBLE;
+        }
+        LATENCY_SCOPE("robot/evaluate_key_poses");
+        if (robot->evaluate_key_pick_and_place_poses(pick_part, place_part)) return KEY_POSES_LOADED;
+        station.infeasible.insert(key);
+        return KEY_POSES_INFEASIBLE;
+    }
+
+private:
+    struct StationEntries {
+        bool have_box_pose;
+        geometry_msgs::Pose box_pose_wrt_world; //box pose the entries were computed for
+        std::set<std::string> infeasible;
+        StationEntries() : have_box_pose(false) {}
+    };
+
+    std::map<unsigned short int, StationEntries> stations_; //by place_part location code
+
+    static long quantise(double value, double quantum) {
+        return lround(value / quantum);
+    }
+
+    static std::string make_key(const inventory_msgs::Part &pick_part, const geometry_msgs::Pose &slot_pose_wrt_box) {
+        std::ostringstream key;
+        key << pick_part.name << '/' << pick_part.location
+                << '/' << quantise(slot_pose_wrt_box.position.x, KEY_POSE_POSITION_QUANTUM)
+                << ',' << quantise(slot_pose_wrt_box.position.y, KEY_POSE_POSITION_QUANTUM)
+                << ',' << quantise(slot_pose_wrt_box.position.z, KEY_POSE_POSITION_QUANTUM)
+                << '/' << quantise(slot_pose_wrt_box.orientation.x, KEY_POSE_ORIENTATION_QUANTUM)
+                << ',' << quantise(slot_pose_wrt_box.orientation.y, KEY_POSE_ORIENTATION_QUANTUM)
+                << ',' << quantise(slot_pose_wrt_box.orientation.z, KEY_POSE_ORIENTATION_QUANTUM)
+                << ',' << quantise(slot_pose_wrt_box.orientation.w, KEY_POSE_ORIENTATION_QUANTUM);
+        return key.str();
+    }
+};
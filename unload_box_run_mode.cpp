@@ -0,0 +1,91 @@
+//unload_box_run_mode.cpp: run modes and step points for unload_box_v4
+// this file is included by unload_box_v4.cpp
+//run modes:
+//  automatic   - full speed, no operator interaction (default)
+//  interactive - pause at each step point until the operator presses enter ("step" is a synonym)
+//  dry-run     - inspect and plan, but command no robot, conveyor or drone motion
+//the mode is read from the private parameter ~run_mode, and a --mode=<mode> command-line argument
+// overrides it; ~step_points (comma-separated names) restricts interactive pauses to those step points
+//building with -DUNLOAD_BOX_NO_STEP_POINTS compiles every STEP_POINT() to nothing, for production builds
+
+#include <iostream>
+#include <set>
+#include <sstream>
+
+enum RunMode {RUN_AUTOMATIC, RUN_INTERACTIVE, RUN_DRY_RUN};
+
+RunMode g_run_mode = RUN_AUTOMATIC;
+std::set<std::string> g_enabled_step_points; //empty: all step points are enabled
+
+const char *run_mode_name(RunMode mode) {
+    switch (mode) {
+        case RUN_INTERACTIVE:
+            return "interactive";
+        case RUN_DRY_RUN:
+            return "dry-run";
+        default:
+            return "automatic";
+    }
+}
+
+bool parse_run_mode(const std::string &name, RunMode &mode) {
+    if (name == "automatic" || name == "auto") {
+        mode = RUN_AUTOMATIC;
+    } else if (name == "interactive" || name == "step") {
+        mode = RUN_INTERACTIVE;
+    } else if (name == "dry-run" || name == "dry_run") {
+        mode = RUN_DRY_RUN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+//set g_run_mode and g_enabled_step_points from parameters and command-line arguments (after ros::init())
+void load_run_mode(int argc, char** argv) {
+    ros::NodeHandle private_nh("~");
+    std::string mode_name, step_points;
+    private_nh.param<std::string>("run_mode", mode_name, run_mode_name(RUN_AUTOMATIC));
+    private_nh.param<std::string>("step_points", step_points, "");
+    const std::string mode_flag("--mode=");
+    for (int i = 1; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.compare(0, mode_flag.size(), mode_flag) == 0) mode_name = arg.substr(mode_flag.size());
+    }
+    if (!parse_run_mode(mode_name, g_run_mode)) {
+        ROS_WARN("unknown run mode %s; running automatic", mode_name.c_str());
+        g_run_mode = RUN_AUTOMATIC;
+    }
+#ifdef UNLOAD_BOX_NO_STEP_POINTS
+    if (g_run_mode == RUN_INTERACTIVE) {
+        ROS_WARN("step points are compiled out of this build; running automatic");
+        g_run_mode = RUN_AUTOMATIC;
+    }
+#endif
+    std::stringstream names(step_points);
+    std::string name;
+    while (std::getline(names, name, ',')) {
+        if (!name.empty()) g_enabled_step_points.insert(name);
+    }
+    ROS_INFO("run mode: %s", run_mode_name(g_run_mode));
+}
+
+bool dry_run() {
+    return g_run_mode == RUN_DRY_RUN;
+}
+
+//pause here if running interactive and this step point is enabled; entering "a" switches to automatic
+void step_point(const char *name, const char *description) {
+    if (g_run_mode != RUN_INTERACTIVE) return;
+    if (!g_enabled_step_points.empty() && g_enabled_step_points.count(name) == 0) return;
+    cout << "[" << name << "] " << description << " -- press enter to continue, a+enter to run automatic: ";
+    std::string ans;
+    std::getline(cin, ans);
+    if (ans == "a") g_run_mode = RUN_AUTOMATIC;
+}
+
+#ifdef UNLOAD_BOX_NO_STEP_POINTS
+#define STEP_POINT(name, description)
+#else
+#define STEP_POINT(name, description) step_point(name, description)
+#endif